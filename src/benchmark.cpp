@@ -468,8 +468,13 @@ BenchmarkSetup setup_benchmark(std::istream& is) {
     else
         setup.originalInvocation += " " + std::to_string(desiredTimeS);
 
+    if (!(is >> setup.hashNumaMode))
+        setup.hashNumaMode = "shared";
+    else
+        setup.originalInvocation += " " + setup.hashNumaMode;
+
     setup.filledInvocation += std::to_string(setup.threads) + " " + std::to_string(setup.ttSize)
-                            + " " + std::to_string(desiredTimeS);
+                            + " " + std::to_string(desiredTimeS) + " " + setup.hashNumaMode;
 
     auto getCorrectedTime = [&](int ply) {
         // time per move is fit roughly based on LTC games
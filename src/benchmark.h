@@ -30,6 +30,7 @@ std::vector<std::string> setup_bench(const std::string&, std::istream&);
 struct BenchmarkSetup {
     int                      ttSize;
     int                      threads;
+    std::string              hashNumaMode;
     std::vector<std::string> commands;
     std::string              originalInvocation;
     std::string              filledInvocation;
@@ -61,9 +61,12 @@ constexpr Bitboard Rank8BB = Rank1BB << (8 * 7);
 extern uint8_t PopCnt16[1 << 16];
 extern uint8_t SquareDistance[SQUARE_NB][SQUARE_NB];
 
-extern Bitboard BetweenBB[SQUARE_NB][SQUARE_NB];
-extern Bitboard LineBB[SQUARE_NB][SQUARE_NB];
-extern Bitboard RayPassBB[SQUARE_NB][SQUARE_NB];
+using SquarePairTable = std::array<std::array<Bitboard, SQUARE_NB>, SQUARE_NB>;
+
+// Generated at compile time in bitboard.cpp
+extern const SquarePairTable BetweenBB;
+extern const SquarePairTable LineBB;
+extern const SquarePairTable RayPassBB;
 
 // Magic holds all magic bitboards relevant data for a single square
 struct Magic {
@@ -0,0 +1,79 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2026 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "counters.h"
+
+#include <iomanip>
+#include <sstream>
+#include <string_view>
+
+namespace Stockfish::Counters {
+
+namespace {
+
+// In the order of the Stages enum of movepick.cpp
+constexpr std::string_view StageNames[MovePickerStages] = {
+  "main tt",    "capture init",  "good capture",  "quiet init", "good quiet", "bad capture",
+  "bad quiet",  "evasion tt",    "evasion init",  "evasion",    "probcut tt", "probcut init",
+  "probcut",    "qsearch tt",    "qcapture init", "qcapture"};
+
+double percent(uint64_t part, uint64_t total) { return total ? 100.0 * part / total : 0.0; }
+
+}  // namespace
+
+std::string merge_to_string(const std::vector<const Block*>& blocks) {
+
+    if (!Enabled)
+        return "Search counters are not available, compile with counters=yes to enable them.";
+
+    Block total;
+    for (const Block* block : blocks)
+        for (int i = 0; i < COUNTER_NB; ++i)
+            total.values[i] += block->values[i];
+
+    const auto& v = total.values;
+    std::stringstream ss;
+
+    auto line = [&](std::string_view name, uint64_t value,
+                    int width = 24) -> std::stringstream& {
+        ss << std::left << std::setw(width) << name << ": " << std::right << std::setw(14) << value;
+        return ss;
+    };
+
+    const uint64_t probes  = v[TTHit] + v[TTMiss];
+    const uint64_t updates = v[NNUERefresh] + v[NNUEIncremental];
+
+    ss << std::fixed << std::setprecision(2);
+    line("TT hits", v[TTHit]) << " (" << percent(v[TTHit], probes) << "%)\n";
+    line("TT misses", v[TTMiss]) << "\n";
+    line("NNUE refreshes", v[NNUERefresh]) << " (" << percent(v[NNUERefresh], updates) << "%)\n";
+    line("NNUE incremental updates", v[NNUEIncremental]) << "\n";
+    line("LMR re-searches", v[LMRResearch]) << "\n";
+    line("Null move cutoffs", v[NullMoveCutoff]) << "\n";
+    ss << "MovePicker stages entered:";
+
+    for (int i = 0; i < MovePickerStages; ++i)
+    {
+        ss << "\n  ";
+        line(StageNames[i], v[MovePickerStage + i], 22);
+    }
+
+    return ss.str();
+}
+
+}  // namespace Stockfish::Counters
@@ -0,0 +1,83 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2026 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef COUNTERS_H_INCLUDED
+#define COUNTERS_H_INCLUDED
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Stockfish::Counters {
+
+// Search counters, only collected when compiled with USE_COUNTERS (make counters=yes).
+// Otherwise every increment compiles to nothing.
+enum Counter : int {
+    TTHit,
+    TTMiss,
+    NNUERefresh,
+    NNUEIncremental,
+    LMRResearch,
+    NullMoveCutoff,
+
+    // One counter per MovePicker stage, incremented each time the stage is entered
+    MovePickerStage,
+    COUNTER_NB = MovePickerStage + 16
+};
+
+constexpr int MovePickerStages = COUNTER_NB - MovePickerStage;
+
+// The counters of one thread, on their own cache line so that the increments
+// of different threads never share one.
+struct alignas(64) Block {
+    void clear() { values.fill(0); }
+
+    std::array<uint64_t, COUNTER_NB> values{};
+};
+
+#ifdef USE_COUNTERS
+
+constexpr bool Enabled = true;
+
+// Each search thread increments its own block, which is registered by the
+// Search::Worker living on that thread.
+inline thread_local Block threadBlock;
+
+inline void inc(Counter c) { ++threadBlock.values[c]; }
+inline void inc_stage(int stage) { ++threadBlock.values[MovePickerStage + stage]; }
+
+inline Block* thread_block() { return &threadBlock; }
+
+#else
+
+constexpr bool Enabled = false;
+
+inline void inc(Counter) {}
+inline void inc_stage(int) {}
+
+inline Block* thread_block() { return nullptr; }
+
+#endif
+
+// Merges the blocks of all the threads and formats the totals, one per line
+std::string merge_to_string(const std::vector<const Block*>& blocks);
+
+}  // namespace Stockfish::Counters
+
+#endif  // #ifndef COUNTERS_H_INCLUDED
@@ -21,6 +21,7 @@
 #include <algorithm>
 #include <cassert>
 #include <deque>
+#include <iomanip>
 #include <iosfwd>
 #include <memory>
 #include <ostream>
@@ -29,7 +30,9 @@
 #include <utility>
 #include <vector>
 
+#include "counters.h"
 #include "evaluate.h"
+#include "microbench.h"
 #include "misc.h"
 #include "nnue/network.h"
 #include "nnue/nnue_common.h"
@@ -66,7 +69,13 @@ Engine::Engine(std::optional<std::string> path) :
     networks(numaContext,
              // Heap-allocate because sizeof(NN::Networks) is large
              std::make_unique<NN::Networks>(NN::EvalFile{EvalFileDefaultNameBig, "None", ""},
-                                            NN::EvalFile{EvalFileDefaultNameSmall, "None", ""})) {
+                                            NN::EvalFile{EvalFileDefaultNameSmall, "None", ""})),
+    telemetry([this]() {
+        return TelemetryCounters{threads.nodes_searched(), threads.tb_hits(),
+                                 threads.best_move_changes(), tt.hashfull()};
+    }) {
+
+    startup_phase("Engine members");
 
     pos.set(StartFEN, false, &states->back());
 
@@ -89,12 +98,29 @@ Engine::Engine(std::optional<std::string> path) :
           return thread_allocation_information_as_string();
       }));
 
+    options.add("ThreadSpin", Option(0, 0, 100000));
+
+    options.add("ThreadStart", Option("staggered var staggered var together", "staggered"));
+
     options.add(  //
       "Hash", Option(16, 1, MaxHashMB, [this](const Option& o) {
           set_tt_size(o);
           return std::nullopt;
       }));
 
+    options.add(  //
+      "HashNumaMode",
+      Option("shared var shared var partitioned var replicated", "shared",
+             [this](const Option& o) {
+                 tt.set_numa_mode(o == "partitioned" ? TranspositionTable::NumaMode::Partitioned
+                                  : o == "replicated" ? TranspositionTable::NumaMode::Replicated
+                                                      : TranspositionTable::NumaMode::Shared);
+                 resize_threads();
+                 return std::nullopt;
+             }));
+
+    options.add("PerftHash", Option(0, 0, MaxHashMB));
+
     options.add(  //
       "Clear Hash", Option([this](const Option&) {
           search_clear();
@@ -107,6 +133,8 @@ Engine::Engine(std::optional<std::string> path) :
     options.add(  //
       "MultiPV", Option(1, 1, MAX_MOVES));
 
+    options.add("MultiPVSearch", Option("sequential var sequential var kbest", "sequential"));
+
     options.add("Skill Level", Option(20, 0, 20));
 
     options.add("Move Overhead", Option(10, 0, 5000));
@@ -124,8 +152,9 @@ Engine::Engine(std::optional<std::string> path) :
     options.add("UCI_ShowWDL", Option(false));
 
     options.add(  //
-      "SyzygyPath", Option("", [](const Option& o) {
+      "SyzygyPath", Option("", [this](const Option& o) {
           Tablebases::init(o);
+          Tablebases::warm_up(int(options["SyzygyWarmup"]));
           return std::nullopt;
       }));
 
@@ -135,6 +164,33 @@ Engine::Engine(std::optional<std::string> path) :
 
     options.add("SyzygyProbeLimit", Option(7, 0, 7));
 
+    options.add(  //
+      "SyzygyCacheSize", Option(256, 0, 65536, [](const Option& o) {
+          Tablebases::set_cache_size(size_t(int(o)));
+          return std::nullopt;
+      }));
+
+    Tablebases::set_cache_size(size_t(int(options["SyzygyCacheSize"])));
+
+    options.add(  //
+      "SyzygyWarmup", Option(0, 0, 7, [](const Option& o) {
+          Tablebases::warm_up(int(o));
+          return std::nullopt;
+      }));
+
+    options.add("SyzygyPrefetch", Option(false));
+
+    options.add(  //
+      "TelemetryFile", Option("", [this](const Option&) { return set_telemetry_from_options(); }));
+
+    options.add(  //
+      "TelemetryFormat", Option("prometheus var prometheus var csv", "prometheus",
+                                [this](const Option&) { return set_telemetry_from_options(); }));
+
+    options.add(  //
+      "TelemetryInterval",
+      Option(1000, 10, 60000, [this](const Option&) { return set_telemetry_from_options(); }));
+
     options.add(  //
       "EvalFile", Option(EvalFileDefaultNameBig, [this](const Option& o) {
           load_big_network(o);
@@ -147,24 +203,53 @@ Engine::Engine(std::optional<std::string> path) :
           return std::nullopt;
       }));
 
+    startup_phase("UCI options");
+
     load_networks();
+    startup_phase("network loading");
+
     resize_threads();
+    startup_phase("threads and hash");
 }
 
 std::uint64_t Engine::perft(const std::string& fen, Depth depth, bool isChess960) {
     verify_networks();
 
-    return Benchmark::perft(fen, depth, isChess960);
+    wait_for_search_finished();
+
+    return Benchmark::perft(fen, depth, isChess960, threads, size_t(options["PerftHash"]));
 }
 
 void Engine::go(Search::LimitsType& limits) {
     assert(limits.perft == 0);
     verify_networks();
 
+    // The previous search must have sent its last sample before this one is counted
+    wait_for_search_finished();
+    telemetry.search_started();
+
     threads.start_thinking(options, pos, states, limits);
 }
 void Engine::stop() { threads.stop = true; }
 
+void Engine::analyse_batch(const std::vector<std::string>&                     fens,
+                           const Search::LimitsType&                           limits,
+                           const std::function<void(size_t, const InfoFull&)>& onResult) {
+    verify_networks();
+    wait_for_search_finished();
+
+    tt.new_search();
+    threads.analyse_batch(fens, options["UCI_Chess960"], limits, onResult);
+}
+
+std::uint64_t Engine::analyse_root_moves(const Search::LimitsType& limits) {
+    verify_networks();
+    wait_for_search_finished();
+
+    tt.new_search();
+    return threads.analyse_root_moves(options, pos, states, limits, updateContext.onUpdateFull);
+}
+
 void Engine::search_clear() {
     wait_for_search_finished();
 
@@ -173,6 +258,7 @@ void Engine::search_clear() {
 
     // @TODO wont work with multiple instances
     Tablebases::init(options["SyzygyPath"]);  // Free mapped files
+    Tablebases::warm_up(int(options["SyzygyWarmup"]));
 }
 
 void Engine::set_on_update_no_moves(std::function<void(const Engine::InfoShort&)>&& f) {
@@ -180,7 +266,10 @@ void Engine::set_on_update_no_moves(std::function<void(const Engine::InfoShort&)
 }
 
 void Engine::set_on_update_full(std::function<void(const Engine::InfoFull&)>&& f) {
-    updateContext.onUpdateFull = std::move(f);
+    updateContext.onUpdateFull = [this, f = std::move(f)](const Engine::InfoFull& info) {
+        telemetry.update_depth(info.depth, info.selDepth);
+        f(info);
+    };
 }
 
 void Engine::set_on_iter(std::function<void(const Engine::InfoIter&)>&& f) {
@@ -188,7 +277,11 @@ void Engine::set_on_iter(std::function<void(const Engine::InfoIter&)>&& f) {
 }
 
 void Engine::set_on_bestmove(std::function<void(std::string_view, std::string_view)>&& f) {
-    updateContext.onBestmove = std::move(f);
+    updateContext.onBestmove = [this, f = std::move(f)](std::string_view bestmove,
+                                                        std::string_view ponder) {
+        telemetry.search_finished();
+        f(bestmove, ponder);
+    };
 }
 
 void Engine::set_on_verify_networks(std::function<void(std::string_view)>&& f) {
@@ -255,6 +348,34 @@ void Engine::set_tt_size(size_t mb) {
     tt.resize(mb, threads);
 }
 
+std::optional<std::string> Engine::set_telemetry_from_options() {
+    const std::string file = options["TelemetryFile"];
+
+    auto error =
+      telemetry.open(file,
+                     options["TelemetryFormat"] == "csv" ? TelemetryExporter::Format::CSV
+                                                         : TelemetryExporter::Format::Prometheus,
+                     options["TelemetryInterval"]);
+
+    if (error)
+        return "ERROR: " + *error;
+
+    if (file.empty())
+        return std::nullopt;
+
+    return "Telemetry written to " + file;
+}
+
+std::optional<std::string> Engine::save_tt(const std::string& file) {
+    wait_for_search_finished();
+    return tt.save(file, threads);
+}
+
+std::optional<std::string> Engine::load_tt(const std::string& file) {
+    wait_for_search_finished();
+    return tt.load(file, threads);
+}
+
 void Engine::set_ponderhit(bool b) { threads.main_manager()->ponder = b; }
 
 // network related
@@ -324,6 +445,13 @@ void Engine::save_network(const std::pair<std::optional<std::string>, std::strin
     });
 }
 
+void Engine::save_raw_network(const std::optional<std::string> files[2]) const {
+    if (files[0])
+        networks->big.save_raw(*files[0]);
+    if (files[1])
+        networks->small.save_raw(*files[1]);
+}
+
 // utility functions
 
 void Engine::trace_eval() const {
@@ -349,6 +477,52 @@ std::string Engine::visualize() const {
     return ss.str();
 }
 
+std::string Engine::microbench() {
+    wait_for_search_finished();
+    verify_networks();
+
+    // The tablebase probes must reach the tables, not the per-thread cache
+    Tablebases::set_cache_size(0);
+    std::string results = Benchmark::microbench(*networks, threads);
+    Tablebases::set_cache_size(size_t(int(options["SyzygyCacheSize"])));
+
+    return results;
+}
+
+std::string Engine::search_counters() const {
+    std::vector<const Counters::Block*> blocks;
+    for (auto it = threads.cbegin(); it != threads.cend(); ++it)
+        if ((*it)->worker->counters)
+            blocks.push_back((*it)->worker->counters);
+
+    const auto tbCache = Tablebases::cache_stats();
+
+    std::stringstream ss;
+    ss << Counters::merge_to_string(blocks) << "\nSyzygy cache hits: " << tbCache.hits << " of "
+       << tbCache.probes << " probes";
+
+    if (tbCache.probes)
+        ss << " (" << std::fixed << std::setprecision(2) << 100.0 * tbCache.hits / tbCache.probes
+           << "%)";
+
+    const auto tbStalls = Tablebases::stall_stats();
+
+    ss << "\nSyzygy stalls: " << tbStalls.lazyMaps << " tables mapped during search, "
+       << tbStalls.slowProbes << " probes slower than 1 ms";
+
+    ss << "\nNNUE accumulators: " << threads.accumulator_bytes() / 1024 << " KiB over "
+       << threads.size() << " threads";
+
+    if (threads.size() < 2)
+        ss << "\nHelper threads searching: no helper threads";
+    else if (const auto latency = threads.helper_start_latency())
+        ss << "\nHelper threads searching: " << latency->count() << " us after go";
+    else
+        ss << "\nHelper threads searching: not all started yet";
+
+    return ss.str();
+}
+
 int Engine::get_hashfull(int maxAge) const { return tt.hashfull(maxAge); }
 
 std::vector<std::pair<size_t, size_t>> Engine::get_bound_thread_count_by_numa_node() const {
@@ -34,6 +34,7 @@
 #include "numa.h"
 #include "position.h"
 #include "search.h"
+#include "telemetry.h"
 #include "syzygy/tbprobe.h"  // for Stockfish::Depth
 #include "thread.h"
 #include "tt.h"
@@ -63,6 +64,13 @@ class Engine {
     void go(Search::LimitsType&);
     // non blocking call to stop searching
     void stop();
+    // blocking call to analyse independent positions, each one on a single thread
+    void analyse_batch(const std::vector<std::string>&                     fens,
+                       const Search::LimitsType&                           limits,
+                       const std::function<void(size_t, const InfoFull&)>& onResult);
+    // blocking call to search each root move on its own, spread over the threads.
+    // The moves are reported sorted through the update listener, returns the node count.
+    std::uint64_t analyse_root_moves(const Search::LimitsType& limits);
 
     // blocking call to wait for search to finish
     void wait_for_search_finished();
@@ -74,6 +82,11 @@ class Engine {
     void set_numa_config_from_option(const std::string& o);
     void resize_threads();
     void set_tt_size(size_t mb);
+    // (re)open the telemetry exporter from the Telemetry* options
+    std::optional<std::string> set_telemetry_from_options();
+    // save/restore the transposition table, returns an error message on failure
+    std::optional<std::string> save_tt(const std::string& file);
+    std::optional<std::string> load_tt(const std::string& file);
     void set_ponderhit(bool);
     void search_clear();
 
@@ -90,6 +103,7 @@ class Engine {
     void load_big_network(const std::string& file);
     void load_small_network(const std::string& file);
     void save_network(const std::pair<std::optional<std::string>, std::string> files[2]);
+    void save_raw_network(const std::optional<std::string> files[2]) const;
 
     // utility functions
 
@@ -100,9 +114,13 @@ class Engine {
 
     int get_hashfull(int maxAge = 0) const;
 
+    // blocking call timing the hot kernels on fixed inputs, returns the results as JSON
+    std::string microbench();
+
     std::string                            fen() const;
     void                                   flip();
     std::string                            visualize() const;
+    std::string                            search_counters() const;
     std::vector<std::pair<size_t, size_t>> get_bound_thread_count_by_numa_node() const;
     std::string                            get_numa_config_as_string() const;
     std::string                            numa_config_information_as_string() const;
@@ -125,6 +143,9 @@ class Engine {
     Search::SearchManager::UpdateContext  updateContext;
     std::function<void(std::string_view)> onVerifyNetworks;
     std::map<NumaIndex, SharedHistories>  sharedHists;
+
+    // Declared last, its thread must be joined before the pool and the TT go away
+    TelemetryExporter telemetry;
 };
 
 }  // namespace Stockfish
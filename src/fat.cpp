@@ -0,0 +1,132 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2026 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// Entry point of a fat binary, built with 'make fat'. The binary holds a copy of
+// the whole engine for each x86-64 architecture of FAT_ARCHS, compiled with its
+// own instruction set in a namespace renamed after the architecture, so that the
+// NNUE layers, the feature transformer updates and the move generation of every
+// copy use the widest vectors available to it. The fastest copy supported by the
+// CPU is run. Setting STOCKFISH_ARCH in the environment runs a given copy instead.
+// This file itself is compiled for the most portable architecture.
+//
+// The static initializers of the copies are moved to a section of their own, as
+// they may use instructions the CPU lacks. Those of the selected copy are run
+// here, before its main().
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+using Init = void (*)();
+
+#define FAT_ENTRY(id) \
+    int Stockfish_##id##_main(int argc, char* argv[]) __attribute__((weak)); \
+    extern "C" const Init __start_fat_init_##id[] __attribute__((weak)); \
+    extern "C" const Init __stop_fat_init_##id[] __attribute__((weak));
+
+// The copies left out of FAT_ARCHS are not linked in, their entry points are null
+FAT_ENTRY(x86_64_avx512icl)
+FAT_ENTRY(x86_64_vnni512)
+FAT_ENTRY(x86_64_avx512)
+FAT_ENTRY(x86_64_avxvnni)
+FAT_ENTRY(x86_64_bmi2)
+FAT_ENTRY(x86_64_avx2)
+FAT_ENTRY(x86_64_sse41_popcnt)
+FAT_ENTRY(x86_64)
+
+namespace {
+
+using Entry = int (*)(int, char*[]);
+
+// __builtin_cpu_supports() only takes string literals
+#define has(feature) __builtin_cpu_supports(feature)
+
+bool has_avx512() {
+    return has("avx2") && has("bmi2") && has("avx512f") && has("avx512bw") && has("avx512dq")
+        && has("avx512vl");
+}
+
+bool has_avx512icl() {
+    return has_avx512() && has("avx512cd") && has("avx512ifma") && has("avx512vbmi")
+        && has("avx512vbmi2") && has("avx512vpopcntdq") && has("avx512bitalg")
+        && has("avx512vnni") && has("vpclmulqdq") && has("gfni") && has("vaes");
+}
+
+// Before Zen 3 the AMD CPUs have a microcoded pext, slower than the fallback
+bool has_fast_pext() {
+    return has("bmi2") && !__builtin_cpu_is("amdfam15h") && !__builtin_cpu_is("amdfam17h");
+}
+
+struct Target {
+    const char* arch;
+    Entry       entry;
+    const Init *initBegin, *initEnd;
+    bool        supported;
+};
+
+#define TARGET(arch, id, supported) \
+    Target { arch, Stockfish_##id##_main, __start_fat_init_##id, __stop_fat_init_##id, supported }
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+
+    __builtin_cpu_init();
+
+    // From the fastest to the most portable, as in FAT_ARCHS
+    const Target targets[] = {
+      TARGET("x86-64-avx512icl", x86_64_avx512icl, has_avx512icl()),
+      TARGET("x86-64-vnni512", x86_64_vnni512, has_avx512() && has("avx512vnni")),
+      TARGET("x86-64-avx512", x86_64_avx512, has_avx512()),
+      TARGET("x86-64-avxvnni", x86_64_avxvnni, has("avx2") && has("bmi2") && has("avxvnni")),
+      TARGET("x86-64-bmi2", x86_64_bmi2, has("avx2") && has_fast_pext()),
+      TARGET("x86-64-avx2", x86_64_avx2,
+             has("avx2") && has("bmi") && has("popcnt") && has("sse4.1")),
+      TARGET("x86-64-sse41-popcnt", x86_64_sse41_popcnt,
+             has("popcnt") && has("sse4.1") && has("ssse3")),
+      TARGET("x86-64", x86_64, true)};
+
+    const char* forced = std::getenv("STOCKFISH_ARCH");
+
+    if (forced && !*forced)
+        forced = nullptr;
+
+    for (const Target& t : targets)
+    {
+        if (!t.entry || (forced && std::strcmp(forced, t.arch)))
+            continue;
+
+        if (t.supported)
+        {
+            for (const Init* init = t.initBegin; init != t.initEnd; ++init)
+                (*init)();
+
+            return t.entry(argc, argv);
+        }
+
+        if (forced)
+        {
+            std::cerr << "The CPU does not support " << t.arch << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::cerr << "No copy of the engine for " << (forced ? forced : "this CPU")
+              << " in this binary, built for " << FAT_ARCHS << std::endl;
+    return EXIT_FAILURE;
+}
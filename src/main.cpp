@@ -16,26 +16,76 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <cstdlib>
 #include <iostream>
 #include <memory>
+#include <string>
 
 #include "bitboard.h"
 #include "misc.h"
+#include "numa.h"
 #include "position.h"
+#include "session.h"
 #include "tune.h"
 #include "uci.h"
 
 using namespace Stockfish;
 
+#if defined(FAT_ARCHS)
+// In a copy of a fat binary, main() is renamed after the architecture and is
+// called by the main() of fat.cpp.
+int main(int argc, char* argv[]);
+#endif
+
 int main(int argc, char* argv[]) {
     std::cout << engine_info() << std::endl;
 
+    // The flag is removed so that the remaining arguments run as UCI commands
+    bool profile = argc > 1 && std::string(argv[1]) == "--startup-profile";
+
+    if (profile)
+    {
+        argv[1] = argv[0];
+        --argc, ++argv;
+    }
+
+    startup_phase("engine info");
+
     Bitboards::init();
+    startup_phase("Bitboards::init");
+
     Position::init();
+    startup_phase("Position::init");
+
+    // Several UCI sessions multiplexed over one process, see session.h
+    if (argc > 1 && std::string(argv[1]) == "--sessions")
+    {
+        startup_done();
+        size_t budget = argc > 2 ? size_t(std::atoi(argv[2])) : size_t(get_hardware_concurrency());
+        SessionHost(argv[0], budget).loop();
+        return 0;
+    }
+
+    if (argc > 2 && std::string(argv[1]) == "--server")
+    {
+        startup_done();
+        size_t budget = argc > 3 ? size_t(std::atoi(argv[3])) : size_t(get_hardware_concurrency());
+        auto   error  = SessionHost(argv[0], budget).serve(argv[2]);
+
+        if (error)
+            std::cerr << *error << std::endl;
+
+        return error ? 1 : 0;
+    }
 
     auto uci = std::make_unique<UCIEngine>(argc, argv);
 
     Tune::init(uci->engine_options());
+    startup_phase("UCI setup");
+    startup_done();
+
+    if (profile)
+        std::cout << startup_profile() << std::endl;
 
     uci->loop();
 
@@ -24,8 +24,11 @@
     #include <features.h>
 #endif
 
-#if defined(__linux__) && !defined(__ANDROID__)
+#ifndef _WIN32
+    #include <fcntl.h>
     #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
 #endif
 
 #if defined(__APPLE__) || defined(__ANDROID__) || defined(__OpenBSD__) \
@@ -196,4 +199,87 @@ void aligned_large_pages_free(void* mem) {
 void aligned_large_pages_free(void* mem) { std_aligned_free(mem); }
 
 #endif
+
+
+// On failure the file is not mapped and data() returns nullptr
+MappedFile::MappedFile(const std::string& fname, size_t writeSize) {
+
+#ifndef _WIN32
+    int fd = writeSize ? ::open(fname.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644)
+                       : ::open(fname.c_str(), O_RDONLY);
+
+    if (fd == -1)
+        return;
+
+    struct stat statbuf;
+
+    if (writeSize ? ftruncate(fd, off_t(writeSize)) != 0 : fstat(fd, &statbuf) != 0)
+    {
+        ::close(fd);
+        return;
+    }
+
+    size_t size = writeSize ? writeSize : size_t(statbuf.st_size);
+    void*  addr = mmap(nullptr, size, writeSize ? PROT_READ | PROT_WRITE : PROT_READ,
+                       MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (addr == MAP_FAILED)
+        return;
+
+    #if defined(MADV_SEQUENTIAL)
+    madvise(addr, size, MADV_SEQUENTIAL);
+    #endif
+#else
+    HANDLE fd =
+      CreateFileA(fname.c_str(), writeSize ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+                  FILE_SHARE_READ, nullptr, writeSize ? CREATE_ALWAYS : OPEN_EXISTING,
+                  FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+    if (fd == INVALID_HANDLE_VALUE)
+        return;
+
+    LARGE_INTEGER fileSize;
+    fileSize.QuadPart = LONGLONG(writeSize);
+
+    if (!writeSize && !GetFileSizeEx(fd, &fileSize))
+    {
+        CloseHandle(fd);
+        return;
+    }
+
+    size_t size = size_t(fileSize.QuadPart);
+    HANDLE mmap = CreateFileMapping(fd, nullptr, writeSize ? PAGE_READWRITE : PAGE_READONLY,
+                                    fileSize.HighPart, fileSize.LowPart, nullptr);
+    CloseHandle(fd);
+
+    if (!mmap)
+        return;
+
+    void* addr = MapViewOfFile(mmap, writeSize ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size);
+
+    if (!addr)
+    {
+        CloseHandle(mmap);
+        return;
+    }
+
+    mapping = mmap;
+#endif
+    data_ = static_cast<char*>(addr);
+    size_ = size;
+}
+
+MappedFile::~MappedFile() {
+    if (!data_)
+        return;
+
+#ifndef _WIN32
+    munmap(data_, size_);
+#else
+    UnmapViewOfFile(data_);
+    CloseHandle(HANDLE(mapping));
+#endif
+}
+
 }  // namespace Stockfish
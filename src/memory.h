@@ -24,6 +24,7 @@
 #include <cstdint>
 #include <memory>
 #include <new>
+#include <string>
 #include <type_traits>
 #include <utility>
 
@@ -70,6 +71,27 @@ void  aligned_large_pages_free(void* mem);
 
 bool has_large_pages();
 
+// Memory maps a file, either an existing one read-only or a new one of the given
+// size for writing. The mapping is released on destruction.
+class MappedFile {
+   public:
+    explicit MappedFile(const std::string& fname, size_t writeSize = 0);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&)            = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    char*  data() const { return data_; }
+    size_t size() const { return size_; }
+
+   private:
+    char*  data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    void* mapping = nullptr;  // HANDLE, windows.h is not included for 32-bit builds
+#endif
+};
+
 // Frees memory which was placed there with placement new.
 // Works for both single objects and arrays of unknown bound.
 template<typename T, typename FREE_FUNC>
@@ -0,0 +1,549 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2026 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "microbench.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <sstream>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "misc.h"
+#include "movegen.h"
+#include "movepick.h"
+#include "nnue/network.h"
+#include "nnue/nnue_accumulator.h"
+#include "position.h"
+#include "syzygy/tbprobe.h"
+#include "tt.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    #include <intrin.h>
+    #define USE_RDTSC
+#elif defined(__x86_64__) || defined(__i386__)
+    #include <x86intrin.h>
+    #define USE_RDTSC
+#endif
+
+namespace Stockfish::Benchmark {
+
+namespace {
+
+// Endgames with up to 5 pieces, for the tablebase probes
+constexpr const char* EndgameFens[] = {
+  "8/8/8/8/8/5k2/8/3QK3 w - - 0 1",       "8/8/4k3/8/8/8/4P3/4K3 w - - 0 1",
+  "8/8/2k5/8/8/3BN3/8/4K3 w - - 0 1",     "4k3/8/8/8/8/8/1PP5/4K3 w - - 0 1",
+  "7r/8/8/3k4/8/8/2R5/4K3 w - - 0 1",     "8/2q5/8/3k4/8/8/3Q4/4K3 b - - 0 1",
+  "8/8/3k4/2p5/8/3K4/3P4/8 w - - 0 1",    "8/5k2/8/8/3K4/8/1P6/1R5r w - - 0 1",
+  "8/8/1k6/8/2r5/8/2PB4/3K4 w - - 0 1",   "8/8/8/4k3/1n6/8/4PP2/4K3 b - - 0 1"};
+
+constexpr int      Rounds     = 9;
+constexpr uint64_t MinRoundNs = 20'000'000;
+constexpr int      TTSizeMB   = 16;
+constexpr size_t   TTStoredNb = 1 << 16;
+
+struct Result {
+    std::string name;
+    uint64_t    ops      = 0;
+    double      ns       = 0, nsMin = 0, cycles = 0;
+    uint64_t    checksum = 0;
+    std::string skipped;
+};
+
+uint64_t cycles_now() {
+#if defined(USE_RDTSC)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+double median(std::vector<double> v) {
+    std::sort(v.begin(), v.end());
+    return v[v.size() / 2];
+}
+
+// Runs a kernel over all its inputs, pass after pass, with as many passes per
+// round as needed for a round to last at least MinRoundNs. The result is the
+// median of the rounds, which is less sensitive than their mean to the noise of
+// a shared machine. A pass returns a checksum of what it computed, so that no
+// work can be optimized away and so that two builds can be checked to do the
+// same work. The time of the baseline, a pass doing everything but the kernel,
+// is subtracted round by round.
+template<typename Pass, typename Baseline>
+Result measure(const std::string& name, uint64_t opsPerPass, Pass&& pass, Baseline&& baseline) {
+
+    using Clock = std::chrono::steady_clock;
+
+    Result r;
+    r.name     = name;
+    r.ops      = opsPerPass;
+    r.checksum = pass();
+
+    const uint64_t baselineChecksum = baseline();
+
+    uint64_t passes     = 1;
+    bool     repeatable = true;
+
+    while (true)
+    {
+        const auto start = Clock::now();
+
+        for (uint64_t i = 0; i < passes; ++i)
+            repeatable &= pass() == r.checksum;
+
+        if (uint64_t(std::chrono::nanoseconds(Clock::now() - start).count()) >= MinRoundNs)
+            break;
+
+        passes *= 2;
+    }
+
+    std::vector<double> ns, cycles;
+
+    for (int round = 0; round < Rounds; ++round)
+    {
+        const auto     start       = Clock::now();
+        const uint64_t startCycles = cycles_now();
+
+        for (uint64_t i = 0; i < passes; ++i)
+            repeatable &= pass() == r.checksum;
+
+        uint64_t elapsedCycles = cycles_now() - startCycles;
+        double   elapsed       = double(std::chrono::nanoseconds(Clock::now() - start).count());
+
+        const auto     baselineStart       = Clock::now();
+        const uint64_t baselineStartCycles = cycles_now();
+
+        for (uint64_t i = 0; i < passes; ++i)
+            repeatable &= baseline() == baselineChecksum;
+
+        elapsedCycles -= std::min(elapsedCycles, cycles_now() - baselineStartCycles);
+        elapsed -= double(std::chrono::nanoseconds(Clock::now() - baselineStart).count());
+
+        ns.push_back(elapsed / double(passes * opsPerPass));
+        cycles.push_back(double(elapsedCycles) / double(passes * opsPerPass));
+    }
+
+    r.ns     = median(ns);
+    r.nsMin  = *std::min_element(ns.begin(), ns.end());
+    r.cycles = median(cycles);
+
+    if (!repeatable)
+        r.skipped = "the results differ from pass to pass";
+
+    return r;
+}
+
+template<typename Pass>
+Result measure(const std::string& name, uint64_t opsPerPass, Pass&& pass) {
+    return measure(name, opsPerPass, pass, [] { return uint64_t(0); });
+}
+
+// The positions and their legal moves, shared by most kernels
+struct Inputs {
+    std::deque<StateInfo>          states;
+    std::vector<Position>          positions;
+    std::vector<std::vector<Move>> moves;
+    uint64_t                       moveCount = 0;
+
+    template<size_t N>
+    explicit Inputs(const char* const (&fens)[N]) :
+        positions(N),
+        moves(N) {
+
+        for (size_t i = 0; i < N; ++i)
+        {
+            states.emplace_back();
+            positions[i].set(fens[i], false, &states.back());
+
+            for (Move m : MoveList<LEGAL>(positions[i]))
+                moves[i].push_back(m);
+
+            moveCount += moves[i].size();
+        }
+    }
+};
+
+// Times the accumulator updates and each layer of the given network
+template<typename Network, Eval::NNUE::IndexType Dimensions>
+void network_kernels(std::vector<Result>&                              results,
+                     const std::string&                                prefix,
+                     const Network&                                    network,
+                     Eval::NNUE::AccumulatorCaches::Cache<Dimensions>& cache,
+                     Inputs&                                           in) {
+
+    using namespace Eval::NNUE;
+
+    const auto& transformer = network.feature_transformer();
+    auto        stack       = std::make_unique<AccumulatorStack>();
+
+    const auto accumulator_checksum = [&](const Position& pos) {
+        const auto& acc = stack->latest<PSQFeatureSet>().template acc<Dimensions>();
+        const Color us  = pos.side_to_move();
+        return uint64_t(uint16_t(acc.accumulation[us][0])) + uint32_t(acc.psqtAccumulation[us][0]);
+    };
+
+    results.push_back(measure(prefix + "accumulator_refresh", in.positions.size(), [&] {
+        uint64_t sum = 0;
+
+        for (const Position& pos : in.positions)
+        {
+            stack->reset();
+            stack->evaluate(pos, transformer, cache);
+            sum += accumulator_checksum(pos);
+        }
+
+        return sum;
+    }));
+
+    // The incremental update cannot be run without making the move, the time
+    // of the same pass without the update is subtracted.
+    const auto incremental = [&](bool update) {
+        uint64_t sum = 0;
+
+        for (size_t i = 0; i < in.positions.size(); ++i)
+        {
+            Position& pos = in.positions[i];
+            StateInfo st;
+
+            stack->reset();
+            stack->evaluate(pos, transformer, cache);
+
+            for (Move m : in.moves[i])
+            {
+                auto [dirtyPiece, dirtyThreats] = stack->push();
+                pos.do_move(m, st, pos.gives_check(m), dirtyPiece, dirtyThreats, nullptr,
+                            nullptr);
+
+                if (update)
+                {
+                    stack->evaluate(pos, transformer, cache);
+                    sum += accumulator_checksum(pos);
+                }
+                else
+                    sum += pos.key() & 0xFFFF;
+
+                pos.undo_move(m);
+                stack->pop();
+            }
+        }
+
+        return sum;
+    };
+
+    results.push_back(measure(prefix + "accumulator_incremental", in.moveCount,
+                              [&] { return incremental(true); },
+                              [&] { return incremental(false); }));
+
+    // Inputs of the layers: the transformed features of each position, then
+    // the output of each layer, computed once before the layer is timed.
+    using Arch   = std::remove_reference_t<decltype(network.layer_stack(0))>;
+    using Buffer = typename Arch::Buffer;
+
+    constexpr size_t FeatureSize = std::remove_reference_t<decltype(transformer)>::BufferSize;
+
+    struct alignas(CacheLineSize) Features {
+        TransformedFeatureType data[FeatureSize];
+    };
+
+    const size_t          n = in.positions.size();
+    std::vector<Features> features(n);
+    std::vector<Buffer>   buffers(n);
+    std::vector<int>      buckets(n);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        const Position& pos = in.positions[i];
+        buckets[i]          = (pos.count<ALL_PIECES>() - 1) / 4;
+        stack->reset();
+        transformer.transform(pos, *stack, cache, features[i].data, buckets[i]);
+    }
+
+    const auto layer = [&](const char* name, auto&& propagate, auto&& output) {
+        for (size_t i = 0; i < n; ++i)
+            propagate(network.layer_stack(buckets[i]), features[i].data, buffers[i]);
+
+        results.push_back(measure(prefix + name, n, [&] {
+            uint64_t sum = 0;
+
+            for (size_t i = 0; i < n; ++i)
+            {
+                propagate(network.layer_stack(buckets[i]), features[i].data, buffers[i]);
+                sum += uint64_t(output(buffers[i]));
+            }
+
+            return sum;
+        }));
+    };
+
+    // In the order of NetworkArchitecture::propagate()
+    layer(
+      "fc_0", [](const Arch& a, const auto* f, Buffer& b) { a.fc_0.propagate(f, b.fc_0_out); },
+      [](const Buffer& b) { return uint32_t(b.fc_0_out[0]); });
+    layer(
+      "ac_sqr_0",
+      [](const Arch& a, const auto*, Buffer& b) {
+          a.ac_sqr_0.propagate(b.fc_0_out, b.ac_sqr_0_out);
+      },
+      [](const Buffer& b) { return b.ac_sqr_0_out[0]; });
+    layer(
+      "ac_0",
+      [](const Arch& a, const auto*, Buffer& b) {
+          a.ac_0.propagate(b.fc_0_out, b.ac_0_out);
+          std::memcpy(b.ac_sqr_0_out + Arch::FC_0_OUTPUTS, b.ac_0_out,
+                      Arch::FC_0_OUTPUTS * sizeof(b.ac_0_out[0]));
+      },
+      [](const Buffer& b) { return b.ac_0_out[0]; });
+    layer(
+      "fc_1",
+      [](const Arch& a, const auto*, Buffer& b) {
+          a.fc_1.propagate(b.ac_sqr_0_out, b.fc_1_out);
+      },
+      [](const Buffer& b) { return uint32_t(b.fc_1_out[0]); });
+    layer(
+      "ac_1",
+      [](const Arch& a, const auto*, Buffer& b) { a.ac_1.propagate(b.fc_1_out, b.ac_1_out); },
+      [](const Buffer& b) { return b.ac_1_out[0]; });
+    layer(
+      "fc_2",
+      [](const Arch& a, const auto*, Buffer& b) { a.fc_2.propagate(b.ac_1_out, b.fc_2_out); },
+      [](const Buffer& b) { return uint32_t(b.fc_2_out[0]); });
+}
+
+std::string to_json(const std::vector<Result>& results) {
+
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(2);
+
+    ss << "{\n  \"engine\": \"" << engine_info() << "\",\n  \"cycles\": \""
+#if defined(USE_RDTSC)
+       << "tsc"
+#else
+       << "unavailable"
+#endif
+       << "\",\n  \"kernels\": [";
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const Result& r = results[i];
+
+        ss << (i ? "," : "") << "\n    {\"name\": \"" << r.name << "\", ";
+
+        if (!r.skipped.empty())
+        {
+            ss << "\"skipped\": \"" << r.skipped << "\"}";
+            continue;
+        }
+
+        ss << "\"ops\": " << r.ops << ", \"ns_per_op\": " << r.ns
+           << ", \"ns_per_op_min\": " << r.nsMin << ", \"cycles_per_op\": ";
+
+#if defined(USE_RDTSC)
+        ss << r.cycles;
+#else
+        ss << "null";
+#endif
+
+        ss << ", \"checksum\": " << r.checksum << "}";
+    }
+
+    ss << "\n  ]\n}";
+    return ss.str();
+}
+
+// Fills the history tables with values in their full range
+template<typename T, int D, bool Atomic>
+void randomize(StatsEntry<T, D, Atomic>& entry, PRNG& rng) {
+    entry = T(int(rng.rand<uint32_t>() % (2 * D + 1)) - D);
+}
+
+template<typename Array>
+void randomize(Array& array, PRNG& rng) {
+    for (auto& child : array)
+        randomize(child, rng);
+}
+
+}  // namespace
+
+RandomHistories::RandomHistories(uint64_t seed) :
+    mainHistory(std::make_unique<ButterflyHistory>()),
+    lowPlyHistory(std::make_unique<LowPlyHistory>()),
+    captureHistory(std::make_unique<CapturePieceToHistory>()),
+    continuationTables(std::make_unique<std::array<PieceToHistory, 6>>()),
+    sharedHistory(1) {
+
+    PRNG rng(seed);
+
+    randomize(*mainHistory, rng);
+    randomize(*lowPlyHistory, rng);
+    randomize(*captureHistory, rng);
+    randomize(*continuationTables, rng);
+
+    for (size_t i = 0; i < sharedHistory.pawnHistory.get_size(); ++i)
+        randomize(sharedHistory.pawnHistory[i], rng);
+
+    for (int i = 0; i < 6; ++i)
+        continuationHistory[i] = &(*continuationTables)[i];
+}
+
+std::string microbench(const Eval::NNUE::Networks& networks, ThreadPool& threads) {
+
+    std::vector<Result> results;
+    Inputs              in(MiddlegameFens);
+
+    results.push_back(measure("movegen_legal", in.positions.size(), [&] {
+        uint64_t sum = 0;
+
+        for (const Position& pos : in.positions)
+            sum += MoveList<LEGAL>(pos).size();
+
+        return sum;
+    }));
+
+    results.push_back(measure("do_undo_move", in.moveCount, [&] {
+        uint64_t  sum = 0;
+        StateInfo st;
+
+        for (size_t i = 0; i < in.positions.size(); ++i)
+            for (Move m : in.moves[i])
+            {
+                in.positions[i].do_move(m, st);
+                sum += in.positions[i].key() & 0xFFFF;
+                in.positions[i].undo_move(m);
+            }
+
+        return sum;
+    }));
+
+    results.push_back(measure("see_ge", in.moveCount, [&] {
+        uint64_t sum = 0;
+
+        for (size_t i = 0; i < in.positions.size(); ++i)
+            for (Move m : in.moves[i])
+                sum += in.positions[i].see_ge(m);
+
+        return sum;
+    }));
+
+    {
+        auto caches = std::make_unique<Eval::NNUE::AccumulatorCaches>(networks);
+
+        network_kernels(results, "big_", networks.big, caches->big, in);
+        network_kernels(results, "small_", networks.small, caches->small, in);
+    }
+
+    {
+        TranspositionTable tt;
+        std::vector<Key>   keys;
+        PRNG               rng(1070372);
+
+        tt.resize(TTSizeMB, threads);
+
+        // Half of the probed keys are stored in the table
+        for (size_t i = 0; i < TTStoredNb; ++i)
+        {
+            const Key key            = rng.rand<Key>();
+            auto [hit, data, writer] = tt.probe(key);
+            writer.write(key, Value(i % 256), false, BOUND_EXACT, Depth(i % 32), Move::none(),
+                         VALUE_NONE, tt.generation());
+            keys.push_back(key);
+            keys.push_back(rng.rand<Key>());
+        }
+
+        results.push_back(measure("tt_probe", keys.size(), [&] {
+            uint64_t sum = 0;
+
+            for (Key key : keys)
+                sum += std::get<0>(tt.probe(key));
+
+            return sum;
+        }));
+    }
+
+    {
+        RandomHistories h(1070372);
+
+        const auto picker_pass = [&](bool checksum) {
+            uint64_t sum = 0;
+
+            for (const Position& pos : in.positions)
+                for (int depth = 1; depth <= 12; ++depth)
+                {
+                    MovePicker mp(pos, Move::none(), depth, h.mainHistory.get(),
+                                  h.lowPlyHistory.get(), h.captureHistory.get(),
+                                  h.continuationHistory, &h.sharedHistory, depth % 8);
+
+                    while (Move m = mp.next_move())
+                        sum += checksum ? m.raw() : 1;
+                }
+
+            return sum;
+        };
+
+        results.push_back(measure("movepick_next_move", picker_pass(false),
+                                  [&] { return picker_pass(true); }));
+    }
+
+    {
+        Inputs   endgames(EndgameFens);
+        uint64_t probes = 0;
+
+        for (size_t i = 0; i < endgames.positions.size(); ++i)
+            if (endgames.positions[i].count<ALL_PIECES>() <= Tablebases::MaxCardinality)
+                probes += 1 + endgames.moves[i].size();
+
+        const auto probe_pass = [&] {
+            uint64_t  sum = 0;
+            StateInfo st;
+
+            for (size_t i = 0; i < endgames.positions.size(); ++i)
+            {
+                Position& pos = endgames.positions[i];
+
+                if (pos.count<ALL_PIECES>() > Tablebases::MaxCardinality)
+                    continue;
+
+                Tablebases::ProbeState result;
+                sum += Tablebases::probe_wdl(pos, &result) + 2;
+
+                for (Move m : endgames.moves[i])
+                {
+                    pos.do_move(m, st);
+                    sum += Tablebases::probe_wdl(pos, &result) + 2;
+                    pos.undo_move(m);
+                }
+            }
+
+            return sum;
+        };
+
+        if (probes)
+            results.push_back(measure("syzygy_probe_wdl", probes, probe_pass));
+        else
+            results.push_back({"syzygy_probe_wdl", 0, 0, 0, 0, 0, "no tablebases loaded"});
+    }
+
+    return to_json(results);
+}
+
+}  // namespace Stockfish::Benchmark
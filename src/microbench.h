@@ -0,0 +1,71 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2026 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MICROBENCH_H_INCLUDED
+#define MICROBENCH_H_INCLUDED
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "history.h"
+
+namespace Stockfish {
+
+class ThreadPool;
+
+namespace Eval::NNUE {
+struct Networks;
+}
+
+namespace Benchmark {
+
+// Quiet-heavy middlegame positions, the inputs of most kernels
+constexpr const char* MiddlegameFens[] = {
+  "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10",
+  "4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - - 7 19",
+  "r3r1k1/2p2ppp/p1p1bn2/8/1q2P3/2NPQN2/PPP3PP/R4RK1 b - - 2 15",
+  "r1bq1rk1/ppp1nppp/4n3/3p3Q/3P4/1BP1B3/PP1N2PP/R4RK1 w - - 1 16",
+  "4r1k1/r1q2ppp/ppp2n2/4P3/5Rb1/1N1BQ3/PPP3PP/R5K1 w - - 1 17",
+  "2rqkb1r/ppp2p2/2npb1p1/1N1Nn2p/2P1PP2/8/PP2B1PP/R1BQK2R b KQ - 0 11",
+  "r1bq1r1k/b1p1npp1/p2p3p/1p6/3PP3/1B2NN2/PP3PPP/R2Q1RK1 w - - 1 16",
+  "3r1rk1/p5pp/bpp1pp2/8/q1PP1P2/b3P3/P2NQRPP/1R2B1K1 b - - 6 22"};
+
+// History tables filled with deterministic random values in their full range,
+// so that a MovePicker can be run outside of a search.
+struct RandomHistories {
+    explicit RandomHistories(std::uint64_t seed);
+
+    std::unique_ptr<ButterflyHistory>              mainHistory;
+    std::unique_ptr<LowPlyHistory>                 lowPlyHistory;
+    std::unique_ptr<CapturePieceToHistory>         captureHistory;
+    std::unique_ptr<std::array<PieceToHistory, 6>> continuationTables;
+    SharedHistories                                sharedHistory;
+    const PieceToHistory*                          continuationHistory[6];
+};
+
+// Times the hot kernels of the engine one by one, on fixed inputs. Returns the
+// results as JSON, in nanoseconds and in TSC cycles per operation.
+std::string microbench(const Eval::NNUE::Networks& networks, ThreadPool& threads);
+
+}  // namespace Benchmark
+
+}  // namespace Stockfish
+
+#endif  // #ifndef MICROBENCH_H_INCLUDED
@@ -235,6 +235,11 @@ std::string compiler_info() {
     compiler += "(undefined architecture)";
 #endif
 
+#if defined(FAT_ARCHS)
+    compiler += "\nCPU dispatch               : selected at startup among ";
+    compiler += FAT_ARCHS;
+#endif
+
     compiler += "\nCompilation settings       : ";
     compiler += (Is64Bit ? "64bit" : "32bit");
 #if defined(USE_AVX512ICL)
@@ -265,6 +270,12 @@ std::string compiler_info() {
     compiler += " NEON";
 #endif
     compiler += (HasPopCnt ? " POPCNT" : "");
+#if defined(TT_CLUSTER_64)
+    compiler += " TT64";
+#endif
+#if defined(USE_COUNTERS)
+    compiler += " COUNTERS";
+#endif
 
 #if !defined(NDEBUG)
     compiler += " DEBUG";
@@ -410,6 +421,60 @@ void dbg_clear() {
     extremes.fill({});
 }
 
+namespace {
+
+using StartupClock = std::chrono::steady_clock;
+using Milliseconds = std::chrono::duration<double, std::milli>;
+
+struct StartupPhase {
+    const char*  name;
+    Milliseconds time;
+};
+
+// Starts with the program, before main() runs
+const StartupClock::time_point StartupTime = StartupClock::now();
+
+StartupClock::time_point  lastStartupPhase = StartupTime;
+std::vector<StartupPhase> startupPhases;
+bool                      startupDone = false;
+std::mutex                startupMutex;
+
+}  // namespace
+
+// Engines are also created later by the sessions, from any thread: their
+// phases are not part of the startup and are not recorded.
+void startup_phase(const char* name) {
+    std::lock_guard<std::mutex> lock(startupMutex);
+
+    if (startupDone)
+        return;
+
+    const auto t = StartupClock::now();
+    startupPhases.push_back({name, t - lastStartupPhase});
+    lastStartupPhase = t;
+}
+
+void startup_done() {
+    std::lock_guard<std::mutex> lock(startupMutex);
+    startupDone = true;
+}
+
+std::string startup_profile() {
+    std::lock_guard<std::mutex> lock(startupMutex);
+    std::stringstream           ss;
+
+    auto line = [&](const char* name, Milliseconds time) {
+        ss << "Startup " << std::left << std::setw(22) << name << std::right << std::fixed
+           << std::setprecision(3) << std::setw(10) << time.count() << " ms";
+    };
+
+    for (const auto& phase : startupPhases)
+        line(phase.name, phase.time), ss << '\n';
+
+    line("total", lastStartupPhase - StartupTime);
+    return ss.str();
+}
+
 // Used to serialize access to std::cout
 // to avoid multiple threads writing at the same time.
 std::ostream& operator<<(std::ostream& os, SyncCout sc) {
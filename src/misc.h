@@ -22,6 +22,7 @@
 #include <algorithm>
 #include <array>
 #include <cassert>
+#include <charconv>
 #include <chrono>
 #include <cstdint>
 #include <cstdio>
@@ -34,6 +35,7 @@
 #include <memory>
 #include <string>
 #include <string_view>
+#include <type_traits>
 #include <vector>
 
 #define stringify2(x) #x
@@ -87,6 +89,13 @@ inline TimePoint now() {
       .count();
 }
 
+// Time spent in each phase of the engine startup, printed with the
+// --startup-profile command line flag. Each call ends the current phase, until
+// startup_done() is called.
+void        startup_phase(const char* name);
+void        startup_done();
+std::string startup_profile();
+
 inline std::vector<std::string_view> split(std::string_view s, std::string_view delimiter) {
     std::vector<std::string_view> res;
 
@@ -370,6 +379,37 @@ class FixedString {
 
     FixedString& operator+=(const FixedString& other) { return (*this += other.c_str()); }
 
+    // Stream-like appends for formatting without allocation, numbers are
+    // written with std::to_chars.
+    FixedString& operator<<(std::string_view str) {
+        if (length_ + str.size() > Capacity)
+            std::terminate();
+        std::memcpy(data_ + length_, str.data(), str.size());
+        length_ += str.size();
+        data_[length_] = '\0';
+        return *this;
+    }
+
+    FixedString& operator<<(char c) {
+        if (length_ == Capacity)
+            std::terminate();
+        data_[length_++] = c;
+        data_[length_]   = '\0';
+        return *this;
+    }
+
+    template<typename T, typename = std::enable_if_t<std::is_integral_v<T>>>
+    FixedString& operator<<(T value) {
+        const auto [end, ec] = std::to_chars(data_ + length_, data_ + Capacity, value);
+        if (ec != std::errc())
+            std::terminate();
+        length_        = std::size_t(end - data_);
+        data_[length_] = '\0';
+        return *this;
+    }
+
+    void pop_back() { data_[length_ -= length_ > 0] = '\0'; }
+
     operator std::string() const { return std::string(data_, length_); }
 
     operator std::string_view() const { return std::string_view(data_, length_); }
@@ -18,14 +18,20 @@
 
 #include "movepick.h"
 
+#include <algorithm>
 #include <cassert>
 #include <limits>
 #include <utility>
 
 #include "bitboard.h"
+#include "counters.h"
 #include "misc.h"
 #include "position.h"
 
+#if defined(USE_AVX2)
+    #include <immintrin.h>
+#endif
+
 namespace Stockfish {
 
 namespace {
@@ -56,6 +62,8 @@ enum Stages {
     QCAPTURE
 };
 
+static_assert(QCAPTURE + 1 == Counters::MovePickerStages);
+
 
 // Sort moves in descending order up to and including a given limit.
 // The order of moves smaller than the limit is left unspecified.
@@ -72,6 +80,83 @@ void partial_insertion_sort(ExtMove* begin, ExtMove* end, int limit) {
         }
 }
 
+#if defined(USE_AVX2)
+
+    #if defined(USE_AVX512)
+constexpr int SortLanes = 16;
+    #else
+constexpr int SortLanes = 8;
+    #endif
+
+// Same result as partial_insertion_sort(), which mispredicts a branch for
+// nearly every move of a long list: where the insertion stops, and whether the
+// move is sorted at all. The moves to be sorted are first partitioned without
+// branches, as the insertion sort does. Then the final index of each of them
+// is its rank, the number of moves with a greater value, or with an equal value
+// and found before it, counted a vector of values at a time.
+void partial_rank_sort(ExtMove* begin, ExtMove* end, int limit) {
+
+    if (end - begin < 2)
+        return;
+
+    alignas(64) int values[MAX_MOVES + SortLanes];
+    ExtMove         sorted[MAX_MOVES];
+    ExtMove*        sortedEnd = begin;
+    int             size      = 1;
+
+    values[0] = begin->value;
+
+    for (ExtMove* p = begin + 1; p < end; ++p)
+    {
+        const ExtMove m = *p, next = *(sortedEnd + 1);
+        const bool    taken = m.value >= limit;
+
+        *p               = taken ? next : m;
+        *(sortedEnd + 1) = taken ? m : next;
+        values[size]     = m.value;
+        sortedEnd += taken;
+        size += taken;
+    }
+
+    // Pad the last vector with values which never count
+    for (int i = size; i % SortLanes; ++i)
+        values[i] = std::numeric_limits<int>::min();
+
+    for (int i = 0; i < size; ++i)
+    {
+        int rank = 0;
+
+        for (int j = 0; j < size; j += SortLanes)
+        {
+            // Lanes holding the moves found before the i-th one
+            const int      d      = i - j;
+            const uint32_t before = d >= SortLanes ? (1U << SortLanes) - 1
+                                  : d <= 0         ? 0
+                                                   : (1U << d) - 1;
+    #if defined(USE_AVX512)
+            const __m512i  v       = _mm512_load_si512(values + j);
+            const __m512i  vi      = _mm512_set1_epi32(values[i]);
+            const uint32_t greater = _mm512_cmpgt_epi32_mask(v, vi);
+            const uint32_t equal   = _mm512_cmpeq_epi32_mask(v, vi);
+    #else
+            const __m256i  v  = _mm256_load_si256(reinterpret_cast<const __m256i*>(values + j));
+            const __m256i  vi = _mm256_set1_epi32(values[i]);
+            const uint32_t greater =
+              _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(v, vi)));
+            const uint32_t equal =
+              _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(v, vi)));
+    #endif
+            rank += popcount(greater | (equal & before));
+        }
+
+        sorted[rank] = begin[i];
+    }
+
+    std::copy(sorted, sorted + size, begin);
+}
+
+#endif
+
 }  // namespace
 
 
@@ -104,6 +189,8 @@ MovePicker::MovePicker(const Position&              p,
 
     else
         stage = (depth > 0 ? MAIN_TT : QSEARCH_TT) + !(ttm && pos.pseudo_legal(ttm));
+
+    Counters::inc_stage(stage);
 }
 
 // MovePicker constructor for ProbCut: we generate captures with Static Exchange
@@ -116,6 +203,7 @@ MovePicker::MovePicker(const Position& p, Move ttm, int th, const CapturePieceTo
     assert(!pos.checkers());
 
     stage = PROBCUT_TT + !(ttm && pos.capture_stage(ttm) && pos.pseudo_legal(ttm));
+    Counters::inc_stage(stage);
 }
 
 // Assigns a numerical value to each move in a list, used for sorting.
@@ -216,7 +304,7 @@ top:
     case EVASION_TT :
     case QSEARCH_TT :
     case PROBCUT_TT :
-        ++stage;
+        Counters::inc_stage(++stage);
         return ttMove;
 
     case CAPTURE_INIT :
@@ -228,7 +316,7 @@ top:
         endCur = endCaptures = score<CAPTURES>(ml);
 
         partial_insertion_sort(cur, endCur, std::numeric_limits<int>::min());
-        ++stage;
+        Counters::inc_stage(++stage);
         goto top;
     }
 
@@ -241,7 +329,7 @@ top:
             }))
             return *(cur - 1);
 
-        ++stage;
+        Counters::inc_stage(++stage);
         [[fallthrough]];
 
     case QUIET_INIT :
@@ -251,10 +339,14 @@ top:
 
             endCur = endGenerated = score<QUIETS>(ml);
 
+#if defined(USE_AVX2)
+            partial_rank_sort(cur, endCur, -3560 * depth);
+#else
             partial_insertion_sort(cur, endCur, -3560 * depth);
+#endif
         }
 
-        ++stage;
+        Counters::inc_stage(++stage);
         [[fallthrough]];
 
     case GOOD_QUIET :
@@ -265,7 +357,7 @@ top:
         cur    = moves;
         endCur = endBadCaptures;
 
-        ++stage;
+        Counters::inc_stage(++stage);
         [[fallthrough]];
 
     case BAD_CAPTURE :
@@ -276,7 +368,7 @@ top:
         cur    = endCaptures;
         endCur = endGenerated;
 
-        ++stage;
+        Counters::inc_stage(++stage);
         [[fallthrough]];
 
     case BAD_QUIET :
@@ -292,7 +384,7 @@ top:
         endCur = endGenerated = score<EVASIONS>(ml);
 
         partial_insertion_sort(cur, endCur, std::numeric_limits<int>::min());
-        ++stage;
+        Counters::inc_stage(++stage);
         [[fallthrough]];
     }
 
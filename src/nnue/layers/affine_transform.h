@@ -196,57 +196,7 @@ class AffineTransform {
 #ifdef ENABLE_SEQ_OPT
 
         if constexpr (OutputDimensions > 1)
-        {
-    #if defined(USE_AVX512)
-            using vec_t = __m512i;
-        #define vec_set_32 _mm512_set1_epi32
-        #define vec_add_dpbusd_32 SIMD::m512_add_dpbusd_epi32
-    #elif defined(USE_AVX2)
-            using vec_t = __m256i;
-        #define vec_set_32 _mm256_set1_epi32
-        #define vec_add_dpbusd_32 SIMD::m256_add_dpbusd_epi32
-    #elif defined(USE_SSSE3)
-            using vec_t = __m128i;
-        #define vec_set_32 _mm_set1_epi32
-        #define vec_add_dpbusd_32 SIMD::m128_add_dpbusd_epi32
-    #elif defined(USE_NEON_DOTPROD)
-            using vec_t = int32x4_t;
-        #define vec_set_32 vdupq_n_s32
-        #define vec_add_dpbusd_32(acc, a, b) \
-            SIMD::dotprod_m128_add_dpbusd_epi32(acc, vreinterpretq_s8_s32(a), \
-                                                vreinterpretq_s8_s32(b))
-    #endif
-
-            static constexpr IndexType OutputSimdWidth = sizeof(vec_t) / sizeof(OutputType);
-
-            static_assert(OutputDimensions % OutputSimdWidth == 0);
-
-            constexpr IndexType NumChunks = ceil_to_multiple<IndexType>(InputDimensions, 8) / 4;
-            constexpr IndexType NumRegs   = OutputDimensions / OutputSimdWidth;
-
-            const auto   input32 = reinterpret_cast<const std::int32_t*>(input);
-            const vec_t* biasvec = reinterpret_cast<const vec_t*>(biases);
-            vec_t        acc[NumRegs];
-            for (IndexType k = 0; k < NumRegs; ++k)
-                acc[k] = biasvec[k];
-
-            for (IndexType i = 0; i < NumChunks; ++i)
-            {
-                const vec_t in0 = vec_set_32(input32[i]);
-                const auto  col0 =
-                  reinterpret_cast<const vec_t*>(&weights[i * OutputDimensions * 4]);
-
-                for (IndexType k = 0; k < NumRegs; ++k)
-                    vec_add_dpbusd_32(acc[k], in0, col0[k]);
-            }
-
-            vec_t* outptr = reinterpret_cast<vec_t*>(output);
-            for (IndexType k = 0; k < NumRegs; ++k)
-                outptr[k] = acc[k];
-
-    #undef vec_set_32
-    #undef vec_add_dpbusd_32
-        }
+            propagate_batch<1>(&input, &output);
         else if constexpr (OutputDimensions == 1)
         {
     // We cannot use AVX512 for the last layer because there are only 32 inputs
@@ -298,6 +248,84 @@ class AffineTransform {
 #endif
     }
 
+    // Forward propagation of N inputs at once, as a small matrix-matrix product:
+    // each chunk of weights is loaded once and applied to all the inputs.
+    template<IndexType N>
+    void propagate_batch(const InputType* const* input, OutputType* const* output) const {
+
+#ifdef ENABLE_SEQ_OPT
+
+        if constexpr (OutputDimensions > 1)
+        {
+    #if defined(USE_AVX512)
+            using vec_t = __m512i;
+        #define vec_set_32 _mm512_set1_epi32
+        #define vec_add_dpbusd_32 SIMD::m512_add_dpbusd_epi32
+    #elif defined(USE_AVX2)
+            using vec_t = __m256i;
+        #define vec_set_32 _mm256_set1_epi32
+        #define vec_add_dpbusd_32 SIMD::m256_add_dpbusd_epi32
+    #elif defined(USE_SSSE3)
+            using vec_t = __m128i;
+        #define vec_set_32 _mm_set1_epi32
+        #define vec_add_dpbusd_32 SIMD::m128_add_dpbusd_epi32
+    #elif defined(USE_NEON_DOTPROD)
+            using vec_t = int32x4_t;
+        #define vec_set_32 vdupq_n_s32
+        #define vec_add_dpbusd_32(acc, a, b) \
+            SIMD::dotprod_m128_add_dpbusd_epi32(acc, vreinterpretq_s8_s32(a), \
+                                                vreinterpretq_s8_s32(b))
+    #endif
+
+            static constexpr IndexType OutputSimdWidth = sizeof(vec_t) / sizeof(OutputType);
+
+            static_assert(OutputDimensions % OutputSimdWidth == 0);
+
+            constexpr IndexType NumChunks = ceil_to_multiple<IndexType>(InputDimensions, 8) / 4;
+            constexpr IndexType NumRegs   = OutputDimensions / OutputSimdWidth;
+
+            const std::int32_t* input32[N];
+            for (IndexType n = 0; n < N; ++n)
+                input32[n] = reinterpret_cast<const std::int32_t*>(input[n]);
+
+            const vec_t* biasvec = reinterpret_cast<const vec_t*>(biases);
+            vec_t        acc[N][NumRegs];
+            for (IndexType n = 0; n < N; ++n)
+                for (IndexType k = 0; k < NumRegs; ++k)
+                    acc[n][k] = biasvec[k];
+
+            for (IndexType i = 0; i < NumChunks; ++i)
+            {
+                const auto col0 =
+                  reinterpret_cast<const vec_t*>(&weights[i * OutputDimensions * 4]);
+
+                vec_t in0[N];
+                for (IndexType n = 0; n < N; ++n)
+                    in0[n] = vec_set_32(input32[n][i]);
+
+                for (IndexType k = 0; k < NumRegs; ++k)
+                    for (IndexType n = 0; n < N; ++n)
+                        vec_add_dpbusd_32(acc[n][k], in0[n], col0[k]);
+            }
+
+            for (IndexType n = 0; n < N; ++n)
+            {
+                vec_t* outptr = reinterpret_cast<vec_t*>(output[n]);
+                for (IndexType k = 0; k < NumRegs; ++k)
+                    outptr[k] = acc[n][k];
+            }
+
+    #undef vec_set_32
+    #undef vec_add_dpbusd_32
+        }
+        else
+#endif
+        {
+            for (IndexType n = 0; n < N; ++n)
+                propagate(input[n], output[n]);
+        }
+    }
+
    private:
     using BiasType   = OutputType;
     using WeightType = std::int8_t;
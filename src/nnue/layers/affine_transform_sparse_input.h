@@ -362,6 +362,97 @@ class AffineTransformSparseInput {
 #endif
     }
 
+    // Forward propagation of N inputs at once. The weights of the blocks that are
+    // nonzero in any of the inputs are loaded once and applied to all of them. Sibling
+    // positions share most of their nonzero blocks, so little work is spent on zeros.
+    template<IndexType N>
+    void propagate_batch(const InputType* const* input, OutputType* const* output) const {
+
+#if (USE_SSSE3 | (USE_NEON >= 8))
+    #if defined(USE_AVX512)
+        using invec_t  = __m512i;
+        using outvec_t = __m512i;
+        #define vec_set_32 _mm512_set1_epi32
+        #define vec_add_dpbusd_32 SIMD::m512_add_dpbusd_epi32
+    #elif defined(USE_AVX2)
+        using invec_t  = __m256i;
+        using outvec_t = __m256i;
+        #define vec_set_32 _mm256_set1_epi32
+        #define vec_add_dpbusd_32 SIMD::m256_add_dpbusd_epi32
+    #elif defined(USE_SSSE3)
+        using invec_t  = __m128i;
+        using outvec_t = __m128i;
+        #define vec_set_32 _mm_set1_epi32
+        #define vec_add_dpbusd_32 SIMD::m128_add_dpbusd_epi32
+    #elif defined(USE_NEON_DOTPROD)
+        using invec_t  = int8x16_t;
+        using outvec_t = int32x4_t;
+        #define vec_set_32(a) vreinterpretq_s8_u32(vdupq_n_u32(a))
+        #define vec_add_dpbusd_32 SIMD::dotprod_m128_add_dpbusd_epi32
+    #elif defined(USE_NEON)
+        using invec_t  = int8x16_t;
+        using outvec_t = int32x4_t;
+        #define vec_set_32(a) vreinterpretq_s8_u32(vdupq_n_u32(a))
+        #define vec_add_dpbusd_32 SIMD::neon_m128_add_dpbusd_epi32
+    #endif
+        constexpr IndexType OutputSimdWidth = sizeof(outvec_t) / sizeof(OutputType);
+        constexpr IndexType NumChunks = ceil_to_multiple<IndexType>(InputDimensions, 8) / ChunkSize;
+        constexpr IndexType NumAccums = OutputDimensions / OutputSimdWidth;
+
+        const std::int32_t* input32[N];
+        for (IndexType n = 0; n < N; ++n)
+            input32[n] = reinterpret_cast<const std::int32_t*>(input[n]);
+
+        // Find indices of the 32-bit blocks that are nonzero in any input
+        alignas(CacheLineSize) std::int32_t anyInput32[NumChunks];
+        for (IndexType i = 0; i < NumChunks; ++i)
+        {
+            anyInput32[i] = input32[0][i];
+            for (IndexType n = 1; n < N; ++n)
+                anyInput32[i] |= input32[n][i];
+        }
+
+        std::uint16_t nnz[NumChunks];
+        IndexType     count;
+
+        find_nnz<NumChunks>(anyInput32, nnz, count);
+
+        const outvec_t* biasvec = reinterpret_cast<const outvec_t*>(biases);
+        outvec_t        acc[N][NumAccums];
+        for (IndexType n = 0; n < N; ++n)
+            for (IndexType k = 0; k < NumAccums; ++k)
+                acc[n][k] = biasvec[k];
+
+        const std::int8_t* weights_cp = weights;
+        for (IndexType j = 0; j < count; ++j)
+        {
+            const std::ptrdiff_t i = nnz[j];
+            const auto           col =
+              reinterpret_cast<const invec_t*>(&weights_cp[i * OutputDimensions * ChunkSize]);
+
+            for (IndexType n = 0; n < N; ++n)
+            {
+                const invec_t in = vec_set_32(input32[n][i]);
+                for (IndexType k = 0; k < NumAccums; ++k)
+                    vec_add_dpbusd_32(acc[n][k], in, col[k]);
+            }
+        }
+
+        for (IndexType n = 0; n < N; ++n)
+        {
+            outvec_t* outptr = reinterpret_cast<outvec_t*>(output[n]);
+            for (IndexType k = 0; k < NumAccums; ++k)
+                outptr[k] = acc[n][k];
+        }
+
+    #undef vec_set_32
+    #undef vec_add_dpbusd_32
+#else
+        for (IndexType n = 0; n < N; ++n)
+            propagate(input[n], output[n]);
+#endif
+    }
+
    private:
     using BiasType   = OutputType;
     using WeightType = std::int8_t;
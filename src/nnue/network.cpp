@@ -18,7 +18,9 @@
 
 #include "network.h"
 
+#include <cassert>
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <optional>
@@ -29,6 +31,7 @@
 #include "../incbin/incbin.h"
 
 #include "../evaluate.h"
+#include "../memory.h"
 #include "../misc.h"
 #include "../position.h"
 #include "../types.h"
@@ -42,8 +45,12 @@
 //     const unsigned char        gEmbeddedNNUEData[];  // a pointer to the embedded data
 //     const unsigned char *const gEmbeddedNNUEEnd;     // a marker to the end
 //     const unsigned int         gEmbeddedNNUESize;    // the size of the embedded file
-// Note that this does not work in Microsoft Visual Studio.
-#if !defined(_MSC_VER) && !defined(NNUE_EMBEDDING_OFF)
+// Note that this does not work in Microsoft Visual Studio. The copies of the engine
+// in a fat binary share the networks embedded by one of them.
+#if !defined(_MSC_VER) && !defined(NNUE_EMBEDDING_OFF) && defined(NNUE_EMBEDDING_EXTERN)
+INCBIN_EXTERN(unsigned char, EmbeddedNNUEBig);
+INCBIN_EXTERN(unsigned char, EmbeddedNNUESmall);
+#elif !defined(_MSC_VER) && !defined(NNUE_EMBEDDING_OFF)
 INCBIN(EmbeddedNNUEBig, EvalFileDefaultNameBig);
 INCBIN(EmbeddedNNUESmall, EvalFileDefaultNameSmall);
 #else
@@ -83,6 +90,28 @@ EmbeddedNNUE get_embedded(EmbeddedNNUEType type) {
 
 namespace Stockfish::Eval::NNUE {
 
+namespace {
+
+// A raw network file holds the parameters exactly as laid out in memory, already
+// decompressed, permuted and scaled, after a header of RawHeaderSize bytes that
+// keeps them page aligned. It is memory mapped and copied as a whole, and can
+// only be loaded by a binary compiled for the same instructions.
+struct RawHeader {
+    char          magic[8];
+    std::uint32_t version;
+    std::uint32_t hash;
+    std::uint32_t layout;
+    std::uint32_t descriptionSize;
+    std::uint64_t parametersSize;
+};
+
+constexpr char        RawMagic[8]   = {'S', 'F', 'N', 'N', 'R', 'A', 'W', '1'};
+constexpr std::size_t RawHeaderSize = 4096;
+
+static_assert(sizeof(RawHeader) + sizeof(EvalFile::netDescription) <= RawHeaderSize,
+              "Raw network header too big");
+
+}  // namespace
 
 namespace Detail {
 
@@ -168,6 +197,44 @@ bool Network<Arch, Transformer>::save(const std::optional<std::string>& filename
 }
 
 
+template<typename Arch, typename Transformer>
+bool Network<Arch, Transformer>::save_raw(const std::string& filename) const {
+
+    static_assert(std::is_trivially_copyable_v<Transformer> && std::is_trivially_copyable_v<Arch>);
+
+    const std::string description = evalFile.netDescription;
+
+    RawHeader header{};
+    std::memcpy(header.magic, RawMagic, sizeof(RawMagic));
+    header.version         = Version;
+    header.hash            = Network::hash;
+    header.layout          = layout_hash();
+    header.descriptionSize = std::uint32_t(description.size());
+    header.parametersSize  = sizeof(featureTransformer) + sizeof(network);
+
+    std::vector<char> head(RawHeaderSize, 0);
+    std::memcpy(head.data(), &header, sizeof(header));
+    std::memcpy(head.data() + sizeof(header), description.data(), description.size());
+
+    bool saved = std::string(evalFile.current) != "None";
+
+    if (saved)
+    {
+        std::ofstream stream(filename, std::ios_base::binary);
+        stream.write(head.data(), head.size());
+        stream.write(reinterpret_cast<const char*>(&featureTransformer),
+                     sizeof(featureTransformer));
+        stream.write(reinterpret_cast<const char*>(network), sizeof(network));
+        saved = bool(stream);
+    }
+
+    sync_cout << (saved ? "Raw network saved successfully to " + filename
+                        : "Failed to export a raw net")
+              << sync_endl;
+    return saved;
+}
+
+
 template<typename Arch, typename Transformer>
 NetworkOutput
 Network<Arch, Transformer>::evaluate(const Position&                         pos,
@@ -189,6 +256,63 @@ Network<Arch, Transformer>::evaluate(const Position&                         pos
 }
 
 
+template<typename Arch, typename Transformer>
+void Network<Arch, Transformer>::evaluate_batch(const Position* const                   pos[],
+                                                AccumulatorStack* const accumulatorStacks[],
+                                                AccumulatorCaches::Cache<FTDimensions>& cache,
+                                                std::size_t                             count,
+                                                NetworkOutput outputs[]) const {
+
+    assert(count <= MaxBatchSize);
+
+    constexpr uint64_t alignment = CacheLineSize;
+
+    alignas(alignment) TransformedFeatureType
+      transformedFeatures[MaxBatchSize][FeatureTransformer<FTDimensions>::BufferSize];
+
+    int          buckets[MaxBatchSize];
+    std::int32_t psqt[MaxBatchSize], positional[MaxBatchSize];
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        buckets[i] = (pos[i]->count<ALL_PIECES>() - 1) / 4;
+        psqt[i]    = featureTransformer.transform(*pos[i], *accumulatorStacks[i], cache,
+                                                  transformedFeatures[i], buckets[i]);
+    }
+
+    // Group the positions by layer stack
+    for (int bucket = 0; bucket < int(LayerStacks); ++bucket)
+    {
+        const TransformedFeatureType* features[MaxBatchSize];
+        std::size_t                   indices[MaxBatchSize];
+        std::size_t                   n = 0;
+
+        for (std::size_t i = 0; i < count; ++i)
+            if (buckets[i] == bucket)
+            {
+                features[n]  = transformedFeatures[i];
+                indices[n++] = i;
+            }
+
+        std::int32_t values[MaxBatchSize];
+        std::size_t  done = 0;
+
+        for (; done + BatchSize <= n; done += BatchSize)
+            network[bucket].template propagate_batch<BatchSize>(&features[done], &values[done]);
+
+        for (; done < n; ++done)
+            values[done] = network[bucket].propagate(features[done]);
+
+        for (std::size_t j = 0; j < n; ++j)
+            positional[indices[j]] = values[j];
+    }
+
+    for (std::size_t i = 0; i < count; ++i)
+        outputs[i] = {static_cast<Value>(psqt[i] / OutputScale),
+                      static_cast<Value>(positional[i] / OutputScale)};
+}
+
+
 template<typename Arch, typename Transformer>
 void Network<Arch, Transformer>::verify(std::string                                  evalfilePath,
                                         const std::function<void(std::string_view)>& f) const {
@@ -262,6 +386,12 @@ Network<Arch, Transformer>::trace_evaluate(const Position&
 template<typename Arch, typename Transformer>
 void Network<Arch, Transformer>::load_user_net(const std::string& dir,
                                                const std::string& evalfilePath) {
+    if (load_raw(dir + evalfilePath))
+    {
+        evalFile.current = evalfilePath;
+        return;
+    }
+
     std::ifstream stream(dir + evalfilePath, std::ios::binary);
     auto          description = load(stream);
 
@@ -300,6 +430,41 @@ void Network<Arch, Transformer>::load_internal() {
 }
 
 
+// Loads a file written by save_raw(), returns false if it is not a raw network
+// compatible with this binary.
+template<typename Arch, typename Transformer>
+bool Network<Arch, Transformer>::load_raw(const std::string& path) {
+
+    MappedFile file(path);
+
+    RawHeader header;
+
+    if (!file.data() || file.size() < RawHeaderSize
+        || std::memcmp(file.data(), RawMagic, sizeof(RawMagic)))
+        return false;
+
+    std::memcpy(&header, file.data(), sizeof(header));
+
+    constexpr std::size_t parametersSize = sizeof(featureTransformer) + sizeof(network);
+
+    if (header.version != Version || header.hash != Network::hash
+        || header.layout != layout_hash() || header.parametersSize != parametersSize
+        || header.descriptionSize > evalFile.netDescription.capacity()
+        || file.size() != RawHeaderSize + parametersSize)
+        return false;
+
+    const char* parameters = file.data() + RawHeaderSize;
+
+    std::memcpy(static_cast<void*>(&featureTransformer), parameters, sizeof(featureTransformer));
+    std::memcpy(static_cast<void*>(network), parameters + sizeof(featureTransformer),
+                sizeof(network));
+
+    evalFile.netDescription = std::string(file.data() + sizeof(header), header.descriptionSize);
+    initialize();
+    return true;
+}
+
+
 template<typename Arch, typename Transformer>
 void Network<Arch, Transformer>::initialize() {
     initialized = true;
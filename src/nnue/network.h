@@ -71,12 +71,31 @@ class Network {
     void load(const std::string& rootDirectory, std::string evalfilePath);
     bool save(const std::optional<std::string>& filename) const;
 
+    // Saves the parameters as laid out in memory, see load_raw()
+    bool save_raw(const std::string& filename) const;
+
     std::size_t get_content_hash() const;
 
     NetworkOutput evaluate(const Position&                         pos,
                            AccumulatorStack&                       accumulatorStack,
                            AccumulatorCaches::Cache<FTDimensions>& cache) const;
 
+    // Evaluates up to MaxBatchSize positions, e.g. the children of a node, each one
+    // with its own accumulator stack. Positions using the same layer stack are
+    // propagated together, BatchSize at a time.
+    static constexpr std::size_t MaxBatchSize = 8;
+    static constexpr IndexType   BatchSize    = 4;
+
+    void evaluate_batch(const Position* const                   pos[],
+                        AccumulatorStack* const                 accumulatorStacks[],
+                        AccumulatorCaches::Cache<FTDimensions>& cache,
+                        std::size_t                             count,
+                        NetworkOutput                           outputs[]) const;
+
+
+    // The parts of the network, timed on their own by the microbenchmarks
+    const Transformer& feature_transformer() const { return featureTransformer; }
+    const Arch&        layer_stack(int bucket) const { return network[bucket]; }
 
     void verify(std::string evalfilePath, const std::function<void(std::string_view)>&) const;
     NnueEvalTrace trace_evaluate(const Position&                         pos,
@@ -86,6 +105,7 @@ class Network {
    private:
     void load_user_net(const std::string&, const std::string&);
     void load_internal();
+    bool load_raw(const std::string&);
 
     void initialize();
 
@@ -112,6 +132,19 @@ class Network {
     // Hash value of evaluation function structure
     static constexpr std::uint32_t hash = Transformer::get_hash_value() ^ Arch::get_hash_value();
 
+    // Identifies the in-memory layout of the parameters, which depends on the
+    // SIMD instructions the engine was compiled for.
+    static constexpr std::uint32_t layout_hash() {
+        std::uint32_t h = std::uint32_t(sizeof(Transformer)) ^ std::uint32_t(sizeof(Arch)) << 8;
+
+        for (std::size_t block : Transformer::PackusEpi16Order)
+            h = h * 31 + std::uint32_t(block);
+
+        h = h * 31 + decltype(Arch::fc_0)::get_weight_index(5);
+        h = h * 31 + decltype(Arch::fc_1)::get_weight_index(5);
+        return h;
+    }
+
     template<IndexType Size>
     friend struct AccumulatorCaches::Cache;
 };
@@ -24,6 +24,7 @@
 #include <type_traits>
 
 #include "../bitboard.h"
+#include "../counters.h"
 #include "../misc.h"
 #include "../position.h"
 #include "../types.h"
@@ -79,58 +80,84 @@ void update_threats_accumulator_full(Color                                 persp
 }
 
 template<typename T>
-const AccumulatorState<T>& AccumulatorStack::latest() const noexcept {
-    return accumulators<T>()[size - 1];
+AccumulatorState<T> AccumulatorStack::latest() noexcept {
+    assert(size <= blockCount * PliesPerBlock);
+    return state<T>(size - 1);
 }
 
 // Explicit template instantiations
-template const AccumulatorState<PSQFeatureSet>&    AccumulatorStack::latest() const noexcept;
-template const AccumulatorState<ThreatFeatureSet>& AccumulatorStack::latest() const noexcept;
+template AccumulatorState<PSQFeatureSet>    AccumulatorStack::latest() noexcept;
+template AccumulatorState<ThreatFeatureSet> AccumulatorStack::latest() noexcept;
 
-template<typename T>
-AccumulatorState<T>& AccumulatorStack::mut_latest() noexcept {
-    return mut_accumulators<T>()[size - 1];
+std::size_t AccumulatorStack::allocated_bytes() const noexcept {
+    return blockCount * sizeof(Block);
 }
 
 template<typename T>
-const std::array<AccumulatorState<T>, AccumulatorStack::MaxSize>&
-AccumulatorStack::accumulators() const noexcept {
+AccumulatorState<T> AccumulatorStack::state(std::size_t ply) noexcept {
     static_assert(std::is_same_v<T, PSQFeatureSet> || std::is_same_v<T, ThreatFeatureSet>,
                   "Invalid Feature Set Type");
 
+    assert(ply < blockCount * PliesPerBlock);
+
+    Block&    block = *blocks[ply / PliesPerBlock];
+    Computed& flags = computed_flags[ply];
+
     if constexpr (std::is_same_v<T, PSQFeatureSet>)
-        return psq_accumulators;
+        return {psq_diffs[ply], &block.psqBig[ply % PliesPerBlock],
+                &block.psqSmall[ply % PliesPerBlock], &flags.psqBig, &flags.psqSmall};
 
     if constexpr (std::is_same_v<T, ThreatFeatureSet>)
-        return threat_accumulators;
+        return {threat_diffs[ply], &block.threatBig[ply % PliesPerBlock], nullptr,
+                &flags.threatBig, nullptr};
 }
 
 template<typename T>
-std::array<AccumulatorState<T>, AccumulatorStack::MaxSize>&
-AccumulatorStack::mut_accumulators() noexcept {
+const typename T::DiffType& AccumulatorStack::diff(std::size_t ply) const noexcept {
     static_assert(std::is_same_v<T, PSQFeatureSet> || std::is_same_v<T, ThreatFeatureSet>,
                   "Invalid Feature Set Type");
 
     if constexpr (std::is_same_v<T, PSQFeatureSet>)
-        return psq_accumulators;
+        return psq_diffs[ply];
 
     if constexpr (std::is_same_v<T, ThreatFeatureSet>)
-        return threat_accumulators;
+        return threat_diffs[ply];
+}
+
+template<typename T, IndexType Dimensions>
+bool AccumulatorStack::computed(std::size_t ply, Color perspective) const noexcept {
+    static_assert(std::is_same_v<T, PSQFeatureSet> || std::is_same_v<T, ThreatFeatureSet>,
+                  "Invalid Feature Set Type");
+
+    if constexpr (std::is_same_v<T, ThreatFeatureSet>)
+        return computed_flags[ply].threatBig[perspective];
+
+    if constexpr (Dimensions == TransformedFeatureDimensionsBig)
+        return computed_flags[ply].psqBig[perspective];
+
+    return computed_flags[ply].psqSmall[perspective];
+}
+
+// Allocates the blocks of the accumulators up to the current ply. The blocks are
+// never freed, so this is done only the first time the search goes that deep.
+void AccumulatorStack::allocate_blocks() noexcept {
+    while (blockCount * PliesPerBlock < size)
+        blocks[blockCount++] = make_unique_aligned<Block>();
 }
 
 void AccumulatorStack::reset() noexcept {
-    psq_accumulators[0].reset({});
-    threat_accumulators[0].reset({});
-    size = 1;
+    psq_diffs[0]      = {};
+    threat_diffs[0]   = {};
+    computed_flags[0] = {};
+    size              = 1;
 }
 
 std::pair<DirtyPiece&, DirtyThreats&> AccumulatorStack::push() noexcept {
     assert(size < MaxSize);
-    auto& dp  = psq_accumulators[size].reset();
-    auto& dts = threat_accumulators[size].reset();
-    new (&dts) DirtyThreats;
+    computed_flags[size] = {};
+    new (&threat_diffs[size]) DirtyThreats;
     size++;
-    return {dp, dts};
+    return {psq_diffs[size - 1], threat_diffs[size - 1]};
 }
 
 void AccumulatorStack::pop() noexcept {
@@ -144,14 +171,17 @@ void AccumulatorStack::evaluate(const Position&                       pos,
                                 AccumulatorCaches::Cache<Dimensions>& cache) noexcept {
     constexpr bool UseThreats = (Dimensions == TransformedFeatureDimensionsBig);
 
+    if (blockCount * PliesPerBlock < size)
+        allocate_blocks();
+
     evaluate_side<PSQFeatureSet>(WHITE, pos, featureTransformer, cache);
 
-    if (UseThreats)
+    if constexpr (UseThreats)
         evaluate_side<ThreatFeatureSet>(WHITE, pos, featureTransformer, cache);
 
     evaluate_side<PSQFeatureSet>(BLACK, pos, featureTransformer, cache);
 
-    if (UseThreats)
+    if constexpr (UseThreats)
         evaluate_side<ThreatFeatureSet>(BLACK, pos, featureTransformer, cache);
 }
 
@@ -164,19 +194,26 @@ void AccumulatorStack::evaluate_side(Color                                 persp
     const auto last_usable_accum =
       find_last_usable_accumulator<FeatureSet, Dimensions>(perspective);
 
-    if ((accumulators<FeatureSet>()[last_usable_accum].template acc<Dimensions>())
-          .computed[perspective])
+    if (computed<FeatureSet, Dimensions>(last_usable_accum, perspective))
+    {
+        Counters::inc(Counters::NNUEIncremental);
         forward_update_incremental<FeatureSet>(perspective, pos, featureTransformer,
                                                last_usable_accum);
-
+    }
     else
     {
+        Counters::inc(Counters::NNUERefresh);
+
         if constexpr (std::is_same_v<FeatureSet, PSQFeatureSet>)
-            update_accumulator_refresh_cache(perspective, featureTransformer, pos,
-                                             mut_latest<PSQFeatureSet>(), cache);
+        {
+            auto target = latest<PSQFeatureSet>();
+            update_accumulator_refresh_cache(perspective, featureTransformer, pos, target, cache);
+        }
         else
-            update_threats_accumulator_full(perspective, featureTransformer, pos,
-                                            mut_latest<ThreatFeatureSet>());
+        {
+            auto target = latest<ThreatFeatureSet>();
+            update_threats_accumulator_full(perspective, featureTransformer, pos, target);
+        }
 
         backward_update_incremental<FeatureSet>(perspective, pos, featureTransformer,
                                                 last_usable_accum);
@@ -190,10 +227,10 @@ std::size_t AccumulatorStack::find_last_usable_accumulator(Color perspective) co
 
     for (std::size_t curr_idx = size - 1; curr_idx > 0; curr_idx--)
     {
-        if ((accumulators<FeatureSet>()[curr_idx].template acc<Dimensions>()).computed[perspective])
+        if (computed<FeatureSet, Dimensions>(curr_idx, perspective))
             return curr_idx;
 
-        if (FeatureSet::requires_refresh(accumulators<FeatureSet>()[curr_idx].diff, perspective))
+        if (FeatureSet::requires_refresh(diff<FeatureSet>(curr_idx), perspective))
             return curr_idx;
     }
 
@@ -207,8 +244,8 @@ void AccumulatorStack::forward_update_incremental(
   const FeatureTransformer<Dimensions>& featureTransformer,
   const std::size_t                     begin) noexcept {
 
-    assert(begin < accumulators<FeatureSet>().size());
-    assert((accumulators<FeatureSet>()[begin].template acc<Dimensions>()).computed[perspective]);
+    assert(begin < size);
+    assert((computed<FeatureSet, Dimensions>(begin, perspective)));
 
     const Square ksq = pos.square<KING>(perspective);
 
@@ -216,18 +253,18 @@ void AccumulatorStack::forward_update_incremental(
     {
         if (next + 1 < size)
         {
-            DirtyPiece& dp1 = mut_accumulators<PSQFeatureSet>()[next].diff;
-            DirtyPiece& dp2 = mut_accumulators<PSQFeatureSet>()[next + 1].diff;
-
-            auto& accumulators = mut_accumulators<FeatureSet>();
+            DirtyPiece& dp1 = psq_diffs[next];
+            DirtyPiece& dp2 = psq_diffs[next + 1];
 
             if constexpr (std::is_same_v<FeatureSet, ThreatFeatureSet>)
             {
                 if (dp2.remove_sq != SQ_NONE
-                    && (accumulators[next].diff.threateningSqs & square_bb(dp2.remove_sq)))
+                    && (threat_diffs[next].threateningSqs & square_bb(dp2.remove_sq)))
                 {
-                    double_inc_update(perspective, featureTransformer, ksq, accumulators[next],
-                                      accumulators[next + 1], accumulators[next - 1], dp2);
+                    auto middle = state<FeatureSet>(next);
+                    auto target = state<FeatureSet>(next + 1);
+                    double_inc_update(perspective, featureTransformer, ksq, middle, target,
+                                      state<FeatureSet>(next - 1), dp2);
                     next++;
                     continue;
                 }
@@ -239,8 +276,10 @@ void AccumulatorStack::forward_update_incremental(
                 {
                     const Square captureSq = dp1.to;
                     dp1.to = dp2.remove_sq = SQ_NONE;
-                    double_inc_update(perspective, featureTransformer, ksq, accumulators[next],
-                                      accumulators[next + 1], accumulators[next - 1]);
+                    auto middle            = state<FeatureSet>(next);
+                    auto target            = state<FeatureSet>(next + 1);
+                    double_inc_update(perspective, featureTransformer, ksq, middle, target,
+                                      state<FeatureSet>(next - 1));
                     dp1.to = dp2.remove_sq = captureSq;
                     next++;
                     continue;
@@ -248,12 +287,12 @@ void AccumulatorStack::forward_update_incremental(
             }
         }
 
-        update_accumulator_incremental<true>(perspective, featureTransformer, ksq,
-                                             mut_accumulators<FeatureSet>()[next],
-                                             accumulators<FeatureSet>()[next - 1]);
+        auto target = state<FeatureSet>(next);
+        update_accumulator_incremental<true>(perspective, featureTransformer, ksq, target,
+                                             state<FeatureSet>(next - 1));
     }
 
-    assert((latest<PSQFeatureSet>().acc<Dimensions>()).computed[perspective]);
+    assert((computed<FeatureSet, Dimensions>(size - 1, perspective)));
 }
 
 template<typename FeatureSet, IndexType Dimensions>
@@ -264,18 +303,19 @@ void AccumulatorStack::backward_update_incremental(
   const FeatureTransformer<Dimensions>& featureTransformer,
   const std::size_t                     end) noexcept {
 
-    assert(end < accumulators<FeatureSet>().size());
     assert(end < size);
-    assert((latest<FeatureSet>().template acc<Dimensions>()).computed[perspective]);
+    assert((computed<FeatureSet, Dimensions>(size - 1, perspective)));
 
     const Square ksq = pos.square<KING>(perspective);
 
     for (std::int64_t next = std::int64_t(size) - 2; next >= std::int64_t(end); next--)
-        update_accumulator_incremental<false>(perspective, featureTransformer, ksq,
-                                              mut_accumulators<FeatureSet>()[next],
-                                              accumulators<FeatureSet>()[next + 1]);
+    {
+        auto target = state<FeatureSet>(next);
+        update_accumulator_incremental<false>(perspective, featureTransformer, ksq, target,
+                                              state<FeatureSet>(next + 1));
+    }
 
-    assert((accumulators<FeatureSet>()[end].template acc<Dimensions>()).computed[perspective]);
+    assert((computed<FeatureSet, Dimensions>(end, perspective)));
 }
 
 // Explicit template instantiations
@@ -496,9 +536,9 @@ void double_inc_update(Color                                                   p
                        AccumulatorState<PSQFeatureSet>&                        target_state,
                        const AccumulatorState<PSQFeatureSet>&                  computed) {
 
-    assert(computed.acc<TransformedFeatureDimensions>().computed[perspective]);
-    assert(!middle_state.acc<TransformedFeatureDimensions>().computed[perspective]);
-    assert(!target_state.acc<TransformedFeatureDimensions>().computed[perspective]);
+    assert(computed.computed<TransformedFeatureDimensions>()[perspective]);
+    assert(!middle_state.computed<TransformedFeatureDimensions>()[perspective]);
+    assert(!target_state.computed<TransformedFeatureDimensions>()[perspective]);
 
     PSQFeatureSet::IndexList removed, added;
     PSQFeatureSet::append_changed_indices(perspective, ksq, middle_state.diff, removed, added);
@@ -529,7 +569,7 @@ void double_inc_update(Color                                                   p
                                                          removed[2]);
     }
 
-    target_state.acc<TransformedFeatureDimensions>().computed[perspective] = true;
+    target_state.computed<TransformedFeatureDimensions>()[perspective] = true;
 }
 
 template<IndexType TransformedFeatureDimensions>
@@ -541,9 +581,9 @@ void double_inc_update(Color                                                   p
                        const AccumulatorState<ThreatFeatureSet>&               computed,
                        const DirtyPiece&                                       dp2) {
 
-    assert(computed.acc<TransformedFeatureDimensions>().computed[perspective]);
-    assert(!middle_state.acc<TransformedFeatureDimensions>().computed[perspective]);
-    assert(!target_state.acc<TransformedFeatureDimensions>().computed[perspective]);
+    assert(computed.computed<TransformedFeatureDimensions>()[perspective]);
+    assert(!middle_state.computed<TransformedFeatureDimensions>()[perspective]);
+    assert(!target_state.computed<TransformedFeatureDimensions>()[perspective]);
 
     ThreatFeatureSet::FusedUpdateData fusedData;
 
@@ -560,7 +600,7 @@ void double_inc_update(Color                                                   p
 
     updateContext.apply(added, removed);
 
-    target_state.acc<TransformedFeatureDimensions>().computed[perspective] = true;
+    target_state.computed<TransformedFeatureDimensions>()[perspective] = true;
 }
 
 template<bool Forward, typename FeatureSet, IndexType TransformedFeatureDimensions>
@@ -571,8 +611,8 @@ void update_accumulator_incremental(
   AccumulatorState<FeatureSet>&                           target_state,
   const AccumulatorState<FeatureSet>&                     computed) {
 
-    assert((computed.template acc<TransformedFeatureDimensions>()).computed[perspective]);
-    assert(!(target_state.template acc<TransformedFeatureDimensions>()).computed[perspective]);
+    assert(computed.template computed<TransformedFeatureDimensions>()[perspective]);
+    assert(!target_state.template computed<TransformedFeatureDimensions>()[perspective]);
 
     // The size must be enough to contain the largest possible update.
     // That might depend on the feature set and generally relies on the
@@ -627,7 +667,7 @@ void update_accumulator_incremental(
         }
     }
 
-    (target_state.template acc<TransformedFeatureDimensions>()).computed[perspective] = true;
+    target_state.template computed<TransformedFeatureDimensions>()[perspective] = true;
 }
 
 Bitboard get_changed_pieces(const std::array<Piece, SQUARE_NB>& oldPieces,
@@ -698,8 +738,8 @@ void update_accumulator_refresh_cache(Color                                 pers
     entry.pieceBB = pos.pieces();
     entry.pieces  = pos.piece_array();
 
-    auto& accumulator                 = accumulatorState.acc<Dimensions>();
-    accumulator.computed[perspective] = true;
+    auto& accumulator = accumulatorState.acc<Dimensions>();
+    accumulatorState.computed<Dimensions>()[perspective] = true;
 
 #ifdef VECTOR
     vec_t      acc[Tiling::NumRegs];
@@ -831,8 +871,8 @@ void update_threats_accumulator_full(Color                                 persp
     ThreatFeatureSet::IndexList active;
     ThreatFeatureSet::append_active_indices(perspective, pos, active);
 
-    auto& accumulator                 = accumulatorState.acc<Dimensions>();
-    accumulator.computed[perspective] = true;
+    auto& accumulator = accumulatorState.acc<Dimensions>();
+    accumulatorState.computed<Dimensions>()[perspective] = true;
 
 #ifdef VECTOR
     vec_t      acc[Tiling::NumRegs];
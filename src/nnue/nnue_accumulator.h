@@ -25,8 +25,10 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <type_traits>
 #include <utility>
 
+#include "../memory.h"
 #include "../types.h"
 #include "nnue_architecture.h"
 #include "nnue_common.h"
@@ -48,7 +50,6 @@ template<IndexType Size>
 struct alignas(CacheLineSize) Accumulator {
     std::array<std::array<std::int16_t, Size>, COLOR_NB>        accumulation;
     std::array<std::array<std::int32_t, PSQTBuckets>, COLOR_NB> psqtAccumulation;
-    std::array<bool, COLOR_NB>                                  computed = {};
 };
 
 
@@ -106,55 +107,74 @@ struct AccumulatorCaches {
 };
 
 
-template<typename FeatureSet>
-struct AccumulatorState {
-    Accumulator<TransformedFeatureDimensionsBig>   accumulatorBig;
-    Accumulator<TransformedFeatureDimensionsSmall> accumulatorSmall;
-    typename FeatureSet::DiffType                  diff;
+class AccumulatorStack;
 
+// The accumulators and the diff of one ply of the AccumulatorStack. The stack
+// keeps each of them in its own array, a state only refers to them. The threat
+// features only feed the big network, so their states have no small accumulator.
+template<typename FeatureSet>
+class AccumulatorState {
+   public:
     template<IndexType Size>
-    auto& acc() noexcept {
+    auto& acc() const noexcept {
         static_assert(Size == TransformedFeatureDimensionsBig
-                        || Size == TransformedFeatureDimensionsSmall,
+                        || (Size == TransformedFeatureDimensionsSmall
+                            && std::is_same_v<FeatureSet, PSQFeatureSet>),
                       "Invalid size for accumulator");
 
         if constexpr (Size == TransformedFeatureDimensionsBig)
-            return accumulatorBig;
+            return *accumulatorBig;
         else if constexpr (Size == TransformedFeatureDimensionsSmall)
-            return accumulatorSmall;
+            return *accumulatorSmall;
     }
 
     template<IndexType Size>
-    const auto& acc() const noexcept {
+    std::array<bool, COLOR_NB>& computed() const noexcept {
         static_assert(Size == TransformedFeatureDimensionsBig
-                        || Size == TransformedFeatureDimensionsSmall,
+                        || (Size == TransformedFeatureDimensionsSmall
+                            && std::is_same_v<FeatureSet, PSQFeatureSet>),
                       "Invalid size for accumulator");
 
         if constexpr (Size == TransformedFeatureDimensionsBig)
-            return accumulatorBig;
+            return *computedBig;
         else if constexpr (Size == TransformedFeatureDimensionsSmall)
-            return accumulatorSmall;
+            return *computedSmall;
     }
 
-    void reset(const typename FeatureSet::DiffType& dp) noexcept {
-        diff = dp;
-        accumulatorBig.computed.fill(false);
-        accumulatorSmall.computed.fill(false);
-    }
+    typename FeatureSet::DiffType& diff;
 
-    typename FeatureSet::DiffType& reset() noexcept {
-        accumulatorBig.computed.fill(false);
-        accumulatorSmall.computed.fill(false);
-        return diff;
-    }
+   private:
+    friend class AccumulatorStack;
+
+    AccumulatorState(typename FeatureSet::DiffType&                  d,
+                     Accumulator<TransformedFeatureDimensionsBig>*   big,
+                     Accumulator<TransformedFeatureDimensionsSmall>* small,
+                     std::array<bool, COLOR_NB>*                     bigComputed,
+                     std::array<bool, COLOR_NB>*                     smallComputed) noexcept :
+        diff(d),
+        accumulatorBig(big),
+        accumulatorSmall(small),
+        computedBig(bigComputed),
+        computedSmall(smallComputed) {}
+
+    Accumulator<TransformedFeatureDimensionsBig>*   accumulatorBig;
+    Accumulator<TransformedFeatureDimensionsSmall>* accumulatorSmall;
+    std::array<bool, COLOR_NB>*                     computedBig;
+    std::array<bool, COLOR_NB>*                     computedSmall;
 };
 
+// The stack of the accumulators along the current line, in a struct-of-arrays
+// layout: the diffs and the computed flags of all the plies are in compact arrays,
+// which are all that find_last_usable_accumulator() reads. The accumulators
+// themselves are allocated by blocks of plies, the first time a ply of a block
+// is evaluated, and the blocks are kept for the next lines. A thread only holds
+// the accumulators of the deepest line it has evaluated, not MaxSize of them.
 class AccumulatorStack {
    public:
     static constexpr std::size_t MaxSize = MAX_PLY + 1;
 
     template<typename T>
-    [[nodiscard]] const AccumulatorState<T>& latest() const noexcept;
+    [[nodiscard]] AccumulatorState<T> latest() noexcept;
 
     void                                  reset() noexcept;
     std::pair<DirtyPiece&, DirtyThreats&> push() noexcept;
@@ -165,15 +185,33 @@ class AccumulatorStack {
                   const FeatureTransformer<Dimensions>& featureTransformer,
                   AccumulatorCaches::Cache<Dimensions>& cache) noexcept;
 
+    // Bytes of the accumulator blocks allocated so far
+    [[nodiscard]] std::size_t allocated_bytes() const noexcept;
+
    private:
-    template<typename T>
-    [[nodiscard]] AccumulatorState<T>& mut_latest() noexcept;
+    static constexpr std::size_t PliesPerBlock = 8;
+    static constexpr std::size_t BlockNb       = (MaxSize + PliesPerBlock - 1) / PliesPerBlock;
+
+    struct Block {
+        std::array<Accumulator<TransformedFeatureDimensionsBig>, PliesPerBlock>   psqBig;
+        std::array<Accumulator<TransformedFeatureDimensionsSmall>, PliesPerBlock> psqSmall;
+        std::array<Accumulator<TransformedFeatureDimensionsBig>, PliesPerBlock>   threatBig;
+    };
+
+    struct Computed {
+        std::array<bool, COLOR_NB> psqBig, psqSmall, threatBig;
+    };
 
     template<typename T>
-    [[nodiscard]] const std::array<AccumulatorState<T>, MaxSize>& accumulators() const noexcept;
+    [[nodiscard]] AccumulatorState<T> state(std::size_t ply) noexcept;
 
     template<typename T>
-    [[nodiscard]] std::array<AccumulatorState<T>, MaxSize>& mut_accumulators() noexcept;
+    [[nodiscard]] const typename T::DiffType& diff(std::size_t ply) const noexcept;
+
+    template<typename T, IndexType Dimensions>
+    [[nodiscard]] bool computed(std::size_t ply, Color perspective) const noexcept;
+
+    void allocate_blocks() noexcept;
 
     template<typename FeatureSet, IndexType Dimensions>
     void evaluate_side(Color                                 perspective,
@@ -196,9 +234,12 @@ class AccumulatorStack {
                                      const FeatureTransformer<Dimensions>& featureTransformer,
                                      const std::size_t                     end) noexcept;
 
-    std::array<AccumulatorState<PSQFeatureSet>, MaxSize>    psq_accumulators;
-    std::array<AccumulatorState<ThreatFeatureSet>, MaxSize> threat_accumulators;
-    std::size_t                                             size = 1;
+    std::array<DirtyPiece, MaxSize>        psq_diffs;
+    std::array<DirtyThreats, MaxSize>      threat_diffs;
+    std::array<Computed, MaxSize>          computed_flags;
+    std::array<AlignedPtr<Block>, BlockNb> blocks;
+    std::size_t                            blockCount = 0;
+    std::size_t                            size       = 1;
 };
 
 }  // namespace Stockfish::Eval::NNUE
@@ -99,19 +99,19 @@ struct NetworkArchitecture {
             && fc_2.write_parameters(stream);
     }
 
-    std::int32_t propagate(const TransformedFeatureType* transformedFeatures) const {
-        struct alignas(CacheLineSize) Buffer {
-            alignas(CacheLineSize) typename decltype(fc_0)::OutputBuffer fc_0_out;
-            alignas(CacheLineSize) typename decltype(ac_sqr_0)::OutputType
-              ac_sqr_0_out[ceil_to_multiple<IndexType>(FC_0_OUTPUTS * 2, 32)];
-            alignas(CacheLineSize) typename decltype(ac_0)::OutputBuffer ac_0_out;
-            alignas(CacheLineSize) typename decltype(fc_1)::OutputBuffer fc_1_out;
-            alignas(CacheLineSize) typename decltype(ac_1)::OutputBuffer ac_1_out;
-            alignas(CacheLineSize) typename decltype(fc_2)::OutputBuffer fc_2_out;
-
-            Buffer() { std::memset(this, 0, sizeof(*this)); }
-        };
+    struct alignas(CacheLineSize) Buffer {
+        alignas(CacheLineSize) typename decltype(fc_0)::OutputBuffer fc_0_out;
+        alignas(CacheLineSize) typename decltype(ac_sqr_0)::OutputType
+          ac_sqr_0_out[ceil_to_multiple<IndexType>(FC_0_OUTPUTS * 2, 32)];
+        alignas(CacheLineSize) typename decltype(ac_0)::OutputBuffer ac_0_out;
+        alignas(CacheLineSize) typename decltype(fc_1)::OutputBuffer fc_1_out;
+        alignas(CacheLineSize) typename decltype(ac_1)::OutputBuffer ac_1_out;
+        alignas(CacheLineSize) typename decltype(fc_2)::OutputBuffer fc_2_out;
+
+        Buffer() { std::memset(this, 0, sizeof(*this)); }
+    };
 
+    std::int32_t propagate(const TransformedFeatureType* transformedFeatures) const {
 #if defined(__clang__) && (__APPLE__)
         // workaround for a bug reported with xcode 12
         static thread_local auto tlsBuffer = std::make_unique<Buffer>();
@@ -130,13 +130,49 @@ struct NetworkArchitecture {
         ac_1.propagate(buffer.fc_1_out, buffer.ac_1_out);
         fc_2.propagate(buffer.ac_1_out, buffer.fc_2_out);
 
-        // buffer.fc_0_out[FC_0_OUTPUTS] is such that 1.0 is equal to 127*(1<<WeightScaleBits) in
-        // quantized form, but we want 1.0 to be equal to 600*OutputScale
-        std::int32_t fwdOut =
-          (buffer.fc_0_out[FC_0_OUTPUTS]) * (600 * OutputScale) / (127 * (1 << WeightScaleBits));
-        std::int32_t outputValue = buffer.fc_2_out[0] + fwdOut;
+        return output_value(buffer);
+    }
 
-        return outputValue;
+    // Same as propagate() for N positions using this layer stack. The affine layers
+    // run on the whole batch at once, so that their weights are loaded once.
+    template<IndexType N>
+    void propagate_batch(const TransformedFeatureType* const* transformedFeatures,
+                         std::int32_t*                        outputValues) const {
+#if defined(__clang__) && (__APPLE__)
+        // workaround for a bug reported with xcode 12
+        static thread_local auto tlsBuffers = std::make_unique<Buffer[]>(N);
+        // Access TLS only once, cache result.
+        Buffer* buffers = tlsBuffers.get();
+#else
+        alignas(CacheLineSize) static thread_local Buffer buffers[N];
+#endif
+
+        typename decltype(fc_0)::OutputType*     fc_0_out[N];
+        typename decltype(ac_sqr_0)::OutputType* ac_sqr_0_out[N];
+        typename decltype(fc_1)::OutputType*     fc_1_out[N];
+        for (IndexType n = 0; n < N; ++n)
+        {
+            fc_0_out[n]     = buffers[n].fc_0_out;
+            ac_sqr_0_out[n] = buffers[n].ac_sqr_0_out;
+            fc_1_out[n]     = buffers[n].fc_1_out;
+        }
+
+        fc_0.template propagate_batch<N>(transformedFeatures, fc_0_out);
+        for (IndexType n = 0; n < N; ++n)
+        {
+            ac_sqr_0.propagate(buffers[n].fc_0_out, buffers[n].ac_sqr_0_out);
+            ac_0.propagate(buffers[n].fc_0_out, buffers[n].ac_0_out);
+            std::memcpy(buffers[n].ac_sqr_0_out + FC_0_OUTPUTS, buffers[n].ac_0_out,
+                        FC_0_OUTPUTS * sizeof(typename decltype(ac_0)::OutputType));
+        }
+        fc_1.template propagate_batch<N>(ac_sqr_0_out, fc_1_out);
+        for (IndexType n = 0; n < N; ++n)
+        {
+            ac_1.propagate(buffers[n].fc_1_out, buffers[n].ac_1_out);
+            fc_2.propagate(buffers[n].ac_1_out, buffers[n].fc_2_out);
+
+            outputValues[n] = output_value(buffers[n]);
+        }
     }
 
     std::size_t get_content_hash() const {
@@ -150,6 +186,17 @@ struct NetworkArchitecture {
         hash_combine(h, get_hash_value());
         return h;
     }
+
+   private:
+    static std::int32_t output_value(const Buffer& buffer) {
+        // buffer.fc_0_out[FC_0_OUTPUTS] is such that 1.0 is equal to 127*(1<<WeightScaleBits) in
+        // quantized form, but we want 1.0 to be equal to 600*OutputScale
+        std::int32_t fwdOut =
+          (buffer.fc_0_out[FC_0_OUTPUTS]) * (600 * OutputScale) / (127 * (1 << WeightScaleBits));
+        std::int32_t outputValue = buffer.fc_2_out[0] + fwdOut;
+
+        return outputValue;
+    }
 };
 
 }  // namespace Stockfish::Eval::NNUE
@@ -234,8 +234,8 @@ class FeatureTransformer {
 
         using namespace SIMD;
         accumulatorStack.evaluate(pos, *this, cache);
-        const auto& accumulatorState       = accumulatorStack.latest<PSQFeatureSet>();
-        const auto& threatAccumulatorState = accumulatorStack.latest<ThreatFeatureSet>();
+        const auto accumulatorState       = accumulatorStack.latest<PSQFeatureSet>();
+        const auto threatAccumulatorState = accumulatorStack.latest<ThreatFeatureSet>();
 
         const Color perspectives[2]  = {pos.side_to_move(), ~pos.side_to_move()};
         const auto& psqtAccumulation = (accumulatorState.acc<HalfDimensions>()).psqtAccumulation;
@@ -254,8 +254,9 @@ class FeatureTransformer {
             psqt /= 2;
 
         const auto& accumulation = (accumulatorState.acc<HalfDimensions>()).accumulation;
+        // The threat features only feed the big network
         const auto& threatAccumulation =
-          (threatAccumulatorState.acc<HalfDimensions>()).accumulation;
+          (threatAccumulatorState.acc<TransformedFeatureDimensionsBig>()).accumulation;
 
         for (IndexType p = 0; p < 2; ++p)
         {
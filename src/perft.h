@@ -19,10 +19,19 @@
 #ifndef PERFT_H_INCLUDED
 #define PERFT_H_INCLUDED
 
+#include <atomic>
+#include <cassert>
+#include <cstddef>
 #include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
 
+#include "memory.h"
+#include "misc.h"
 #include "movegen.h"
 #include "position.h"
+#include "thread.h"
 #include "types.h"
 #include "uci.h"
 
@@ -62,6 +71,147 @@ inline uint64_t perft(const std::string& fen, Depth depth, bool isChess960) {
 
     return perft<true>(p, depth);
 }
+
+// Hash table of leaf counts indexed by (position key, depth), shared without
+// locks by the perft threads. Each entry stores the key xored with its data,
+// so an entry torn by concurrent writes fails the key check instead of
+// returning a wrong count. Entries are always replaced.
+class PerftTable {
+
+    struct Entry {
+        std::atomic<uint64_t> keyXorData;
+        std::atomic<uint64_t> data;  // count << 8 | depth
+    };
+
+   public:
+    explicit PerftTable(size_t mbSize) :
+        entryCount(mbSize * 1024 * 1024 / sizeof(Entry)),
+        table(make_unique_large_page<Entry[]>(entryCount)) {}
+
+    bool probe(Key key, Depth depth, uint64_t& count) const {
+        const Entry&   e    = table[mul_hi64(key, entryCount)];
+        const uint64_t data = e.data.load(std::memory_order_relaxed);
+
+        if ((e.keyXorData.load(std::memory_order_relaxed) ^ data) != key
+            || Depth(data & 0xFF) != depth)
+            return false;
+
+        count = data >> 8;
+        return true;
+    }
+
+    void store(Key key, Depth depth, uint64_t count) {
+        assert(count < (uint64_t(1) << 56));
+
+        Entry&         e    = table[mul_hi64(key, entryCount)];
+        const uint64_t data = count << 8 | uint64_t(depth);
+
+        e.keyXorData.store(key ^ data, std::memory_order_relaxed);
+        e.data.store(data, std::memory_order_relaxed);
+    }
+
+   private:
+    size_t                entryCount;
+    LargePagePtr<Entry[]> table;
+};
+
+// Counts the leaf nodes below a non-root position, using the table if any
+inline uint64_t perft_count(Position& pos, Depth depth, PerftTable* table) {
+
+    if (depth <= 1)
+        return depth == 1 ? MoveList<LEGAL>(pos).size() : 1;
+
+    if (!table)
+        return perft<false>(pos, depth);
+
+    uint64_t nodes = 0;
+
+    if (table->probe(pos.key(), depth, nodes))
+        return nodes;
+
+    StateInfo st;
+
+    for (const auto& m : MoveList<LEGAL>(pos))
+    {
+        pos.do_move(m, st);
+        nodes += perft_count(pos, depth - 1, table);
+        pos.undo_move(m);
+    }
+
+    table->store(pos.key(), depth, nodes);
+    return nodes;
+}
+
+// Multithreaded perft. The subtrees below the moves at the split ply (the root,
+// or the ply after it when there are enough nodes to go around) are handed out
+// to the threads of the pool, which count them with an optional shared table.
+// The per root move counts are printed in the usual order once all are done.
+inline uint64_t perft(const std::string& fen,
+                      Depth              depth,
+                      bool               isChess960,
+                      ThreadPool&        threads,
+                      size_t             hashMB) {
+
+    if (depth <= 1 || (threads.num_threads() == 1 && !hashMB))
+        return perft(fen, depth, isChess960);
+
+    // A subtree to count, given by the moves leading to it from the root
+    struct Split {
+        size_t rootIdx;
+        Move   moves[2];
+        int    count;
+    };
+
+    StateInfo st, st2;
+    Position  pos;
+    pos.set(fen, isChess960, &st);
+
+    const MoveList<LEGAL> rootMoves(pos);
+    const int             splitPly = depth >= 4 ? 2 : 1;
+    std::vector<Split>    splits;
+
+    for (size_t i = 0; i < rootMoves.size(); ++i)
+    {
+        const Move m = rootMoves.begin()[i];
+
+        if (splitPly == 1)
+        {
+            splits.push_back({i, {m, Move::none()}, 1});
+            continue;
+        }
+
+        pos.do_move(m, st2);
+        for (const auto& m2 : MoveList<LEGAL>(pos))
+            splits.push_back({i, {m, m2}, 2});
+        pos.undo_move(m);
+    }
+
+    std::unique_ptr<PerftTable> table(hashMB ? new PerftTable(hashMB) : nullptr);
+    std::vector<std::atomic<uint64_t>> rootCounts(rootMoves.size());
+
+    threads.parallel_for(splits.size(), 1, [&](size_t idx, size_t, size_t) {
+        const Split& split = splits[idx];
+        StateInfo    states[3];
+        Position     p;
+        p.set(fen, isChess960, &states[0]);
+
+        for (int ply = 0; ply < split.count; ++ply)
+            p.do_move(split.moves[ply], states[ply + 1]);
+
+        rootCounts[split.rootIdx] += perft_count(p, depth - split.count, table.get());
+    });
+
+    uint64_t nodes = 0;
+
+    for (size_t i = 0; i < rootMoves.size(); ++i)
+    {
+        nodes += rootCounts[i];
+        sync_cout << UCIEngine::move(rootMoves.begin()[i], isChess960) << ": " << rootCounts[i]
+                  << sync_endl;
+    }
+
+    return nodes;
+}
 }
 
 #endif  // PERFT_H_INCLUDED
@@ -26,6 +26,7 @@
 #include <cmath>
 #include <cstdint>
 #include <cstdlib>
+#include <functional>
 #include <initializer_list>
 #include <iostream>
 #include <list>
@@ -34,6 +35,7 @@
 #include <utility>
 
 #include "bitboard.h"
+#include "counters.h"
 #include "evaluate.h"
 #include "history.h"
 #include "misc.h"
@@ -161,6 +163,7 @@ Search::Worker::Worker(SharedState&                    sharedState,
                        NumaReplicatedAccessToken       token) :
     // Unpack the SharedState struct into member variables
     sharedHistory(sharedState.sharedHistories.at(token.get_numa_index())),
+    counters(Counters::thread_block()),
     threadIdx(threadId),
     numaThreadIdx(numaThreadId),
     numaTotal(numaTotalThreads),
@@ -168,7 +171,7 @@ Search::Worker::Worker(SharedState&                    sharedState,
     manager(std::move(sm)),
     options(sharedState.options),
     threads(sharedState.threads),
-    tt(sharedState.tt),
+    tt(sharedState.tt.numa_table(token.get_numa_index())),
     networks(sharedState.networks),
     refreshTable(networks[token]) {
     clear();
@@ -253,6 +256,99 @@ void Search::Worker::start_searching() {
     main_manager()->updates.onBestmove(bestmove, ponder);
 }
 
+void Search::Worker::analyse(const std::string&                           fen,
+                             bool                                         isChess960,
+                             const LimitsType&                            batchLimits,
+                             const std::function<void(const InfoFull&)>& onResult) {
+
+    rootPos.set(fen, isChess960, &rootState);
+
+    rootMoves.clear();
+    for (const auto& m : MoveList<LEGAL>(rootPos))
+        rootMoves.emplace_back(m);
+
+    tbConfig = Tablebases::rank_root_moves(options, rootPos, rootMoves);
+
+    analyse_root(batchLimits, onResult);
+}
+
+void Search::Worker::analyse(const Position&                              pos,
+                             const StateInfo&                             setupState,
+                             const RootMove&                              move,
+                             const Tablebases::Config&                    rootTbConfig,
+                             const LimitsType&                            moveLimits,
+                             const std::function<void(const InfoFull&)>& onResult) {
+
+    // As in ThreadPool::start_thinking(), the previous states are shared
+    rootPos.set(pos.fen(), pos.is_chess960(), &rootState);
+    rootState = setupState;
+    rootMoves = {move};
+    tbConfig  = rootTbConfig;
+
+    analyse_root(moveLimits, onResult);
+}
+
+// Searches the root moves set up by analyse() with this worker alone
+void Search::Worker::analyse_root(const LimitsType&                            analyseLimits,
+                                  const std::function<void(const InfoFull&)>& onResult) {
+
+    limits = analyseLimits;
+    nodes = tbHits = bestMoveChanges = 0;
+    nmpMinPly                        = 0;
+    rootDepth = completedDepth = 0;
+
+    accumulatorStack.reset();
+
+    TimePoint start = now();
+    Value     v     = rootPos.checkers() ? -VALUE_MATE : VALUE_DRAW;
+    InfoFull  info{};
+
+    if (!rootMoves.empty())
+    {
+        standalone = true;
+        iterative_deepening();
+        standalone = false;
+
+        const RootMove& rm = rootMoves[0];
+
+        v = rm.uciScore != -VALUE_INFINITE ? rm.uciScore : VALUE_ZERO;
+        if (tbConfig.rootInTB && std::abs(v) <= VALUE_TB)
+            v = rm.tbScore;
+
+        info.depth    = completedDepth;
+        info.selDepth = rm.selDepth;
+        info.multiPV  = 1;
+        info.bound    = rm.scoreLowerbound ? "lowerbound" : rm.scoreUpperbound ? "upperbound" : "";
+    }
+
+    std::string wdl = options["UCI_ShowWDL"] ? UCIEngine::wdl(v, rootPos) : "";
+    std::string pv;
+    for (size_t i = 0; !rootMoves.empty() && i < rootMoves[0].pv.size(); ++i)
+        pv += UCIEngine::move(rootMoves[0].pv[i], rootPos.is_chess960()) + " ";
+
+    // Remove last whitespace
+    if (!pv.empty())
+        pv.pop_back();
+
+    TimePoint time = std::max(TimePoint(1), now() - start);
+
+    info.score  = {v, rootPos};
+    info.wdl    = wdl;
+    info.timeMs = time;
+    info.nodes  = nodes;
+    info.nps    = nodes * 1000 / time;
+    info.tbHits = tbHits + (tbConfig.rootInTB ? rootMoves.size() : 0);
+    info.pv     = pv;
+
+    if (!rootMoves.empty())
+    {
+        info.pvMoves  = rootMoves[0].pv.data();
+        info.pvLength = rootMoves[0].pv.size();
+    }
+
+    onResult(info);
+}
+
 // Main iterative deepening loop. It calls search()
 // repeatedly with increasing depth until the allocated thinking time has been
 // consumed, the user stops the search, or the maximum search depth is reached.
@@ -309,6 +405,16 @@ void Search::Worker::iterative_deepening() {
 
     multiPV = std::min(multiPV, rootMoves.size());
 
+    // With MultiPVSearch kbest all the lines are searched in a single pass over
+    // the root moves, with the root alpha following the k-th best score instead
+    // of one aspiration search per line. Root moves of different tablebase ranks
+    // are still searched rank by rank, in the sequential way.
+    rootKBest = multiPV > 1 && options["MultiPVSearch"] == "kbest"
+                    && rootMoves.front().tbRank == rootMoves.back().tbRank
+                  ? multiPV
+                  : 0;
+    const size_t pvPasses = rootKBest ? 1 : multiPV;
+
     int searchAgainCounter = 0;
 
     lowPlyHistory.fill(97);
@@ -320,7 +426,7 @@ void Search::Worker::iterative_deepening() {
 
     // Iterative deepening loop until requested to stop or the target depth is reached
     while (++rootDepth < MAX_PLY && !threads.stop
-           && !(limits.depth && mainThread && rootDepth > limits.depth))
+           && !(limits.depth && (mainThread || standalone) && rootDepth > limits.depth))
     {
         // Age out PV variability metric
         if (mainThread)
@@ -337,8 +443,9 @@ void Search::Worker::iterative_deepening() {
         if (!threads.increaseDepth)
             searchAgainCounter++;
 
-        // MultiPV loop. We perform a full root search for each PV line
-        for (pvIdx = 0; pvIdx < multiPV; ++pvIdx)
+        // MultiPV loop. We perform a full root search for each PV line, or a
+        // single one for all of them in k-best mode.
+        for (pvIdx = 0; pvIdx < pvPasses; ++pvIdx)
         {
             if (pvIdx == pvLast)
             {
@@ -351,10 +458,12 @@ void Search::Worker::iterative_deepening() {
             // Reset UCI info selDepth for each depth and each PV line
             selDepth = 0;
 
-            // Reset aspiration window starting size
+            // Reset aspiration window starting size. In k-best mode the window
+            // spans from the last line to the first one.
             delta     = 5 + threadIdx % 8 + std::abs(rootMoves[pvIdx].meanSquaredScore) / 9000;
             Value avg = rootMoves[pvIdx].averageScore;
-            alpha     = std::max(avg - delta, -VALUE_INFINITE);
+            Value low = rootKBest ? std::min(avg, rootMoves[rootKBest - 1].averageScore) : avg;
+            alpha     = std::max(low - delta, -VALUE_INFINITE);
             beta      = std::min(avg + delta, VALUE_INFINITE);
 
             // Adjust optimism based on root move's averageScore
@@ -372,6 +481,7 @@ void Search::Worker::iterative_deepening() {
                 Depth adjustedDepth =
                   std::max(1, rootDepth - failedHighCnt - 3 * (searchAgainCounter + 1) / 4);
                 rootDelta = beta - alpha;
+                kBestValues.clear();
                 bestValue = search<Root>(rootPos, ss, alpha, beta, adjustedDepth, false);
 
                 // Bring the best move to the front. It is critical that sorting
@@ -395,12 +505,19 @@ void Search::Worker::iterative_deepening() {
                     && nodes > 10000000)
                     main_manager()->pv(*this, threads, tt, rootDepth);
 
+                // In k-best mode the search fails low when the last line does, unless
+                // the first one failed high and the other moves were not searched.
+                Value lowValue =
+                  rootKBest && bestValue < beta ? rootMoves[rootKBest - 1].score : bestValue;
+
                 // In case of failing low/high increase aspiration window and re-search,
                 // otherwise exit the loop.
-                if (bestValue <= alpha)
+                if (lowValue <= alpha)
                 {
-                    beta  = alpha;
-                    alpha = std::max(bestValue - delta, -VALUE_INFINITE);
+                    if (!rootKBest)
+                        beta = alpha;
+
+                    alpha = std::max(lowValue - delta, -VALUE_INFINITE);
 
                     failedHighCnt = 0;
                     if (mainThread)
@@ -408,8 +525,10 @@ void Search::Worker::iterative_deepening() {
                 }
                 else if (bestValue >= beta)
                 {
-                    alpha = std::max(beta - delta, alpha);
-                    beta  = std::min(bestValue + delta, VALUE_INFINITE);
+                    if (!rootKBest)
+                        alpha = std::max(beta - delta, alpha);
+
+                    beta = std::min(bestValue + delta, VALUE_INFINITE);
                     ++failedHighCnt;
                 }
                 else
@@ -424,7 +543,7 @@ void Search::Worker::iterative_deepening() {
             std::stable_sort(rootMoves.begin() + pvFirst, rootMoves.begin() + pvIdx + 1);
 
             if (mainThread
-                && (threads.stop || pvIdx + 1 == multiPV || nodes > 10000000)
+                && (threads.stop || pvIdx + 1 == pvPasses || nodes > 10000000)
                 // A thread that aborted search can have mated-in/TB-loss PV and
                 // score that cannot be trusted, i.e. it can be delayed or refuted
                 // if we would have had time to fully search other root-moves. Thus
@@ -458,6 +577,11 @@ void Search::Worker::iterative_deepening() {
             lastBestMoveDepth = rootDepth;
         }
 
+        // Without a main thread checking the node count, a standalone search
+        // stops after the first iteration that exceeds its node budget.
+        if (standalone && limits.nodes && nodes >= limits.nodes)
+            break;
+
         if (!mainThread)
             continue;
 
@@ -593,6 +717,9 @@ void Search::Worker::clear() {
 
     ttMoveHistory = 0;
 
+    if (counters)
+        counters->clear();
+
     for (auto& to : continuationCorrectionHistory)
         for (auto& h : to)
             h.fill(8);
@@ -616,8 +743,9 @@ Value Search::Worker::search(
   Position& pos, Stack* ss, Value alpha, Value beta, Depth depth, bool cutNode) {
 
     constexpr bool PvNode   = nodeType != NonPV;
-    constexpr bool rootNode = nodeType == Root;
-    const bool     allNode  = !(PvNode || cutNode);
+    constexpr bool rootNode  = nodeType == Root;
+    const bool     allNode   = !(PvNode || cutNode);
+    const bool     kBestRoot = rootNode && rootKBest;
 
     // Dive into quiescence search when the depth reaches zero
     if (depth <= 0)
@@ -851,6 +979,10 @@ Value Search::Worker::search(
                 }
             }
         }
+
+        // One capture away from the probed tables, have them read ahead
+        else if (piecesCount == tbConfig.cardinality + 1 && tbConfig.prefetch)
+            Tablebases::prefetch(pos);
     }
 
     if (ss->inCheck)
@@ -907,7 +1039,10 @@ Value Search::Worker::search(
         if (nullValue >= beta && !is_win(nullValue))
         {
             if (nmpMinPly || depth < 16)
+            {
+                Counters::inc(Counters::NullMoveCutoff);
                 return nullValue;
+            }
 
             assert(!nmpMinPly);  // Recursive verification is not allowed
 
@@ -920,7 +1055,10 @@ Value Search::Worker::search(
             nmpMinPly = 0;
 
             if (v >= beta)
+            {
+                Counters::inc(Counters::NullMoveCutoff);
                 return nullValue;
+            }
         }
     }
 
@@ -1023,8 +1161,9 @@ moves_loop:  // When in check, search starts here
 
         if (rootNode && is_mainthread() && nodes > 10000000)
         {
-            main_manager()->updates.onIter(
-              {depth, UCIEngine::move(move, pos.is_chess960()), moveCount + pvIdx});
+            UCIEngine::InfoString currmove;
+            UCIEngine::append_move(currmove, move, pos.is_chess960());
+            main_manager()->updates.onIter({depth, currmove, moveCount + pvIdx});
         }
         if (PvNode)
             (ss + 1)->pv = nullptr;
@@ -1253,7 +1392,10 @@ moves_loop:  // When in check, search starts here
                 newDepth += doDeeperSearch - doShallowerSearch;
 
                 if (newDepth > d)
+                {
+                    Counters::inc(Counters::LMRResearch);
                     value = -search<NonPV>(pos, ss + 1, -(alpha + 1), -alpha, newDepth, !cutNode);
+                }
 
                 // Post LMR continuation history updates
                 update_continuation_histories(ss, movedPiece, move.to_sq(), 1365);
@@ -1342,7 +1484,7 @@ moves_loop:  // When in check, search starts here
                 // We record how often the best move has been changed in each iteration.
                 // This information is used for time management. In MultiPV mode,
                 // we must take care to only do this for the first PV line.
-                if (moveCount > 1 && !pvIdx)
+                if (moveCount > 1 && !pvIdx && (!kBestRoot || value > bestValue))
                     ++bestMoveChanges;
             }
             else
@@ -1376,12 +1518,32 @@ moves_loop:  // When in check, search starts here
                     break;
                 }
 
-                // Reduce other moves if we have found at least one score improvement
-                if (depth > 2 && depth < 14 && !is_decisive(value))
-                    depth -= 2;
+                // In k-best mode alpha is raised below, and all the lines are
+                // searched to the same depth.
+                if (!kBestRoot)
+                {
+                    // Reduce other moves if we have found at least one score improvement
+                    if (depth > 2 && depth < 14 && !is_decisive(value))
+                        depth -= 2;
+
+                    assert(depth > 0);
+                    alpha = value;  // Update alpha! Always alpha < beta
+                }
+            }
+        }
+
+        // In k-best mode alpha is the k-th best score found so far, so that any
+        // move which may still enter the k lines is searched with an open window.
+        if (kBestRoot && value > alpha)
+        {
+            kBestValues.insert(
+              std::upper_bound(kBestValues.begin(), kBestValues.end(), value, std::greater<>()),
+              value);
 
-                assert(depth > 0);
-                alpha = value;  // Update alpha! Always alpha < beta
+            if (kBestValues.size() >= rootKBest)
+            {
+                kBestValues.resize(rootKBest);
+                alpha = kBestValues.back();
             }
         }
 
@@ -2145,15 +2307,24 @@ void SearchManager::pv(Search::Worker&           worker,
             && ((!rootMoves[i].scoreLowerbound && !rootMoves[i].scoreUpperbound) || isExact))
             syzygy_extend_pv(worker.options, worker.limits, pos, rootMoves[i], v);
 
-        std::string pv;
-        for (Move m : rootMoves[i].pv)
-            pv += UCIEngine::move(m, pos.is_chess960()) + " ";
+        // A PV extended by the tablebases can be longer than MAX_PLY moves, it is
+        // cut so that the info lines fit their buffers.
+        const size_t pvLength = std::min(rootMoves[i].pv.size(), size_t(MAX_PLY));
+
+        UCIEngine::InfoString pv;
+        for (size_t j = 0; j < pvLength; ++j)
+        {
+            UCIEngine::append_move(pv, rootMoves[i].pv[j], pos.is_chess960());
+            pv << ' ';
+        }
 
         // Remove last whitespace
-        if (!pv.empty())
-            pv.pop_back();
+        pv.pop_back();
+
+        UCIEngine::InfoString wdl;
+        if (worker.options["UCI_ShowWDL"])
+            UCIEngine::append_wdl(wdl, v, pos);
 
-        auto wdl   = worker.options["UCI_ShowWDL"] ? UCIEngine::wdl(v, pos) : "";
         auto bound = rootMoves[i].scoreLowerbound
                      ? "lowerbound"
                      : (rootMoves[i].scoreUpperbound ? "upperbound" : "");
@@ -2175,6 +2346,8 @@ void SearchManager::pv(Search::Worker&           worker,
         info.nps       = nodes * 1000 / time;
         info.tbHits    = tbHits;
         info.pv        = pv;
+        info.pvMoves   = rootMoves[i].pv.data();
+        info.pvLength  = pvLength;
         info.hashfull  = tt.hashfull();
 
         updates.onUpdateFull(info);
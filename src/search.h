@@ -32,6 +32,7 @@
 #include <string_view>
 #include <vector>
 
+#include "counters.h"
 #include "history.h"
 #include "misc.h"
 #include "nnue/network.h"
@@ -177,6 +178,8 @@ struct InfoFull: InfoShort {
     size_t           nps;
     size_t           tbHits;
     std::string_view pv;
+    const Move*      pvMoves  = nullptr;  // The same PV as moves, pvLength of them
+    size_t           pvLength = 0;
     int              hashfull;
 };
 
@@ -282,7 +285,24 @@ class Worker {
     // It searches from the root position and outputs the "bestmove".
     void start_searching();
 
-    bool is_mainthread() const { return threadIdx == 0; }
+    // Called for each position of a batch analysis. The position is searched by
+    // this worker alone, up to the depth or node count given in the limits, and
+    // the result is reported through the given callback.
+    void analyse(const std::string&                           fen,
+                 bool                                         isChess960,
+                 const LimitsType&                            batchLimits,
+                 const std::function<void(const InfoFull&)>& onResult);
+
+    // Called for each root move of a split root analysis. Only the given move is
+    // searched from the position, whose history is taken from setupState.
+    void analyse(const Position&                              pos,
+                 const StateInfo&                             setupState,
+                 const RootMove&                              move,
+                 const Tablebases::Config&                    rootTbConfig,
+                 const LimitsType&                            moveLimits,
+                 const std::function<void(const InfoFull&)>& onResult);
+
+    bool is_mainthread() const { return threadIdx == 0 && !standalone; }
 
     void ensure_network_replicated();
 
@@ -297,7 +317,11 @@ class Worker {
     TTMoveHistory    ttMoveHistory;
     SharedHistories& sharedHistory;
 
+    // Counters of the thread the worker lives on, nullptr when compiled out
+    Counters::Block* const counters;
+
    private:
+    void analyse_root(const LimitsType&, const std::function<void(const InfoFull&)>&);
     void iterative_deepening();
 
     void do_move(Position& pos, const Move move, StateInfo& st, Stack* const ss);
@@ -331,6 +355,8 @@ class Worker {
     LimitsType limits;
 
     size_t                pvIdx, pvLast;
+    size_t                rootKBest;  // Lines searched in a single root pass, 0 if disabled
+    std::vector<Value>    kBestValues;
     std::atomic<uint64_t> nodes, tbHits, bestMoveChanges;
     int                   selDepth, nmpMinPly;
 
@@ -345,6 +371,9 @@ class Worker {
     size_t                    threadIdx, numaThreadIdx, numaTotal;
     NumaReplicatedAccessToken numaAccessToken;
 
+    // Set while searching a batch position, no other thread takes part in the search
+    bool standalone = false;
+
     // Reductions lookup table initialized at startup
     std::array<int, MAX_MOVES> reductions;  // [depth or moveNumber]
 
@@ -0,0 +1,756 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2026 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "session.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+    #include <arpa/inet.h>
+    #include <netinet/in.h>
+    #include <sys/epoll.h>
+    #include <sys/socket.h>
+    #include <sys/stat.h>
+    #include <sys/un.h>
+    #include <unistd.h>
+#endif
+
+#include "misc.h"
+#include "uci.h"
+#include "ucioption.h"
+
+namespace Stockfish {
+
+namespace {
+
+// Enough for the output of a search at a high MultiPV between two flushes
+constexpr size_t OutputReserve = 64 * 1024;
+
+// The commands that act on the running search, even before the commands
+// received earlier have run.
+bool controls_search(const std::string& cmd) {
+    std::istringstream is(cmd);
+    std::string        token;
+
+    is >> std::skipws >> token;
+    return token == "stop" || token == "ponderhit";
+}
+
+}  // namespace
+
+SessionHost::Session::Session(const std::string& n, const std::string& binaryPath, int f) :
+    name(n),
+    engine(binaryPath),
+    fd(f) {
+    output.reserve(OutputReserve);
+}
+
+SessionHost::SessionHost(std::string path, size_t threadBudget) :
+    binaryPath(std::move(path)),
+    scheduler(std::max<size_t>(threadBudget, 1)) {}
+
+SessionHost::~SessionHost() {
+    while (!sessions.empty())
+        close(sessions.begin()->first);
+
+    join_reaper();
+}
+
+void SessionHost::loop() {
+    std::string line, name, cmd;
+
+    while (std::getline(std::cin, line))
+    {
+        std::istringstream is(line);
+
+        name.clear();
+        cmd.clear();
+        is >> std::skipws >> name;
+
+        if (name.empty() || name[0] == '#')
+            continue;
+
+        if (name == "quit")
+            break;
+
+        std::getline(is >> std::ws, cmd);
+
+        if (cmd == "quit")
+            close(name);
+
+        else if (!cmd.empty())
+            post(session(name), cmd);
+    }
+}
+
+SessionHost::Session& SessionHost::session(const std::string& name, int fd) {
+    auto it = sessions.find(name);
+
+    if (it != sessions.end())
+        return *it->second;
+
+    Session& s =
+      *sessions.emplace(name, std::make_unique<Session>(name, binaryPath, fd)).first->second;
+
+    s.engine.get_options().add_info_listener([this, &s](const std::optional<std::string>& str) {
+        if (str.has_value())
+            print_info_string(s, *str);
+    });
+
+    // The info lines are formatted on the stack and appended to the output
+    // buffer, so that a search does not allocate for them.
+    s.engine.set_on_iter([this, &s](const auto& i) {
+        UCIEngine::InfoString line;
+        UCIEngine::append_info_iter(line, i);
+        print_line(s, line);
+    });
+    s.engine.set_on_update_no_moves([this, &s](const auto& i) {
+        UCIEngine::InfoString line;
+        UCIEngine::append_info_no_moves(line, i);
+        print_line(s, line);
+    });
+    s.engine.set_on_update_full([this, &s](const auto& i) {
+        UCIEngine::InfoString line;
+        UCIEngine::append_info_full(line, i, s.engine.get_options()["UCI_ShowWDL"]);
+        print_line(s, line);
+    });
+    s.engine.set_on_bestmove([this, &s](const auto& bm, const auto& p) {
+        finish_search(s, UCIEngine::format_bestmove(bm, p));
+    });
+    s.engine.set_on_verify_networks([this, &s](const auto& str) { print_info_string(s, str); });
+
+    s.commandThread = std::thread(&SessionHost::run_commands, this, std::ref(s));
+
+    return s;
+}
+
+// Runs a command at once, unless it would wait for the search of the session or
+// follows such a command: it is then queued for the command thread, and stop
+// and ponderhit are still run at once.
+void SessionHost::post(Session& s, const std::string& cmd) {
+
+    std::istringstream is(cmd);
+    std::string        token;
+
+    is >> std::skipws >> token;
+
+    bool queued;
+
+    {
+        std::lock_guard<std::mutex> lk(s.commandMutex);
+
+        queued = s.busy || !s.commands.empty();
+
+        if (!queued && (token == "setoption" || token == "ucinewgame"))
+        {
+            std::lock_guard<std::mutex> lk2(mutex);
+            queued = s.searchThreads || s.waitingSearch;
+        }
+
+        if (queued)
+            s.commands.push_back(cmd);
+    }
+
+    if (queued)
+        s.commandCv.notify_one();
+
+    if (!queued || controls_search(cmd))
+        execute(s, cmd);
+}
+
+void SessionHost::run_commands(Session& s) {
+
+    std::unique_lock<std::mutex> lk(s.commandMutex);
+
+    while (true)
+    {
+        s.commandCv.wait(lk, [&] { return s.closing || !s.commands.empty(); });
+
+        if (s.closing)
+            return;
+
+        std::string cmd = std::move(s.commands.front());
+        s.commands.pop_front();
+        s.busy = true;
+
+        lk.unlock();
+        execute(s, cmd);
+        lk.lock();
+
+        // A stop or ponderhit queued after the command was run when received,
+        // maybe before the command started a search. It is run again before the
+        // next command, which may wait for that search.
+        std::vector<std::string> controls;
+
+        for (const auto& c : s.commands)
+            if (controls_search(c))
+                controls.push_back(c);
+
+        lk.unlock();
+        for (const auto& c : controls)
+            execute(s, c);
+        lk.lock();
+
+        s.busy = false;
+    }
+}
+
+void SessionHost::execute(Session& s, const std::string& cmd) {
+    std::istringstream is(cmd);
+    std::string        token;
+
+    is >> std::skipws >> token;
+
+    // Commands that change the engine must not race with the search about to
+    // be started by another session.
+    if (token == "go" || token == "position" || token == "setoption" || token == "ucinewgame")
+    {
+        std::lock_guard<std::mutex> lk(mutex);
+
+        if (s.waitingSearch)
+        {
+            print_info_string(s, "ERROR: " + token + " is not allowed while a search waits");
+            return;
+        }
+    }
+
+    if (token == "stop")
+        stop(s);
+
+    else if (token == "ponderhit")
+    {
+        std::lock_guard<std::mutex> lk(mutex);
+
+        if (s.waitingSearch)
+            s.waitingSearch->ponderMode = false;
+        else
+            s.engine.set_ponderhit(false);
+    }
+
+    else if (token == "uci")
+    {
+        std::stringstream ss;
+        ss << "id name " << engine_info(true) << "\n" << s.engine.get_options() << "\nuciok";
+        print(s, ss.str());
+    }
+
+    else if (token == "setoption")
+        setoption(s, is);
+    else if (token == "go")
+        go(s, is);
+    else if (token == "position")
+    {
+        std::string              fen;
+        std::vector<std::string> moves;
+
+        if (UCIEngine::parse_position(is, fen, moves))
+            s.engine.set_position(fen, moves);
+    }
+    else if (token == "ucinewgame")
+        s.engine.search_clear();
+    else if (token == "isready")
+        print(s, "readyok");
+    else if (token == "d")
+        print(s, s.engine.visualize());
+    else if (token == "stats")
+        print(s, s.engine.search_counters());
+    else if (token[0] != '#')
+        print(s, "Unknown command: '" + cmd + "'. Sessions accept only UCI commands.");
+}
+
+void SessionHost::go(Session& s, std::istringstream& is) {
+
+    Search::LimitsType limits = UCIEngine::parse_limits(is);
+
+    if (limits.perft)
+    {
+        print_info_string(s, "ERROR: perft is not available in a session");
+        return;
+    }
+
+    std::lock_guard<std::mutex> lk(mutex);
+
+    if (s.searchThreads)
+    {
+        print_info_string(s, "ERROR: a search is already running");
+        return;
+    }
+
+    s.waitingSearch = limits;
+    queue.push_back(&s);
+    dispatch();
+}
+
+void SessionHost::stop(Session& s) {
+
+    std::lock_guard<std::mutex> lk(mutex);
+
+    // A waiting search must still send its best move, so start it at once
+    // even if it goes beyond the budget for a moment.
+    if (s.waitingSearch)
+    {
+        queue.erase(std::find(queue.begin(), queue.end(), &s));
+        start_search(s);
+    }
+
+    s.engine.stop();
+}
+
+void SessionHost::setoption(Session& s, std::istringstream& is) {
+
+    s.engine.wait_for_search_finished();
+
+    OptionsMap& options = s.engine.get_options();
+    options.setoption(is);
+
+    if (size_t(options["Threads"]) > scheduler.budget())
+    {
+        std::istringstream ss("name Threads value " + std::to_string(scheduler.budget()));
+        options.setoption(ss);
+        print_info_string(s, "Threads limited to the budget of "
+                                    + std::to_string(scheduler.budget()) + " of the host");
+    }
+}
+
+// Drops the session and its pending commands, and stops its search. The rest
+// of the teardown is left to the reaper thread.
+void SessionHost::close(const std::string& name) {
+
+    auto it = sessions.find(name);
+
+    if (it == sessions.end())
+        return;
+
+    std::unique_ptr<Session> s = std::move(it->second);
+    sessions.erase(it);
+
+    {
+        std::lock_guard<std::mutex> lk(s->commandMutex);
+        s->closing = true;
+        s->commands.clear();
+    }
+
+    s->commandCv.notify_one();
+    cancel_search(*s);
+
+    {
+        std::lock_guard<std::mutex> lk(reapMutex);
+        closed.push_back(std::move(s));
+
+        if (!reaper.joinable())
+            reaper = std::thread(&SessionHost::reap, this);
+    }
+
+    reapCv.notify_one();
+}
+
+void SessionHost::cancel_search(Session& s) {
+
+    std::lock_guard<std::mutex> lk(mutex);
+
+    if (s.waitingSearch)
+    {
+        queue.erase(std::find(queue.begin(), queue.end(), &s));
+        s.waitingSearch.reset();
+    }
+
+    s.engine.stop();
+}
+
+void SessionHost::reap() {
+
+    std::unique_lock<std::mutex> lk(reapMutex);
+
+    while (true)
+    {
+        reapCv.wait(lk, [&] { return stopReaper || !closed.empty(); });
+
+        if (closed.empty())
+            return;
+
+        std::unique_ptr<Session> s = std::move(closed.front());
+        closed.pop_front();
+
+        lk.unlock();
+
+        // The running command may wait for the search, or start one before the
+        // command thread exits.
+        s->commandThread.join();
+        cancel_search(*s);
+
+        // The best move of a running search is still sent, which releases its
+        // threads. The socket is closed only then, so that its descriptor is
+        // not reused by a new client while the search may still write to it.
+        s->engine.wait_for_search_finished();
+
+#ifdef __linux__
+        if (s->fd >= 0)
+            ::close(s->fd);
+#endif
+
+        s.reset();
+        lk.lock();
+    }
+}
+
+// Waits until all the closed sessions are torn down
+void SessionHost::join_reaper() {
+
+    {
+        std::lock_guard<std::mutex> lk(reapMutex);
+        stopReaper = true;
+    }
+
+    reapCv.notify_one();
+
+    if (reaper.joinable())
+        reaper.join();
+
+    stopReaper = false;
+}
+
+void SessionHost::dispatch() {
+
+    while (!queue.empty())
+    {
+        Session& s = *queue.front();
+
+        if (!scheduler.fits(size_t(s.engine.get_options()["Threads"])))
+            break;
+
+        queue.pop_front();
+        start_search(s);
+    }
+}
+
+void SessionHost::start_search(Session& s) {
+
+    s.searchThreads = size_t(s.engine.get_options()["Threads"]);
+    scheduler.acquire(s.searchThreads);
+
+    Search::LimitsType limits = *s.waitingSearch;
+    s.waitingSearch.reset();
+
+    // The engine threads of the session are idle, so this does not block on
+    // the mutex even when called from the best move of another session.
+    s.engine.go(limits);
+}
+
+// Runs on the main search thread of the session, after its last output
+void SessionHost::finish_search(Session& s, const std::string& bestmove) {
+
+    std::lock_guard<std::mutex> lk(mutex);
+
+    scheduler.release(s.searchThreads);
+    s.searchThreads = 0;
+
+    print(s, bestmove);
+    dispatch();
+}
+
+void SessionHost::print(Session& s, std::string_view text, std::string_view linePrefix) {
+
+    std::lock_guard<std::mutex> lk(s.outputMutex);
+
+    for (auto& line : split(text, "\n"))
+        if (!is_whitespace(line))
+            append_line(s, line, linePrefix);
+
+    flush(s);
+}
+
+void SessionHost::print_line(Session& s, std::string_view line) {
+
+    std::lock_guard<std::mutex> lk(s.outputMutex);
+
+    append_line(s, line, {});
+    flush(s);
+}
+
+void SessionHost::append_line(Session& s, std::string_view line, std::string_view linePrefix) {
+
+    if (s.fd < 0)
+        s.output.append(s.name).push_back(' ');
+
+    s.output.append(linePrefix).append(line).push_back('\n');
+}
+
+void SessionHost::print_info_string(Session& s, std::string_view text) {
+    print(s, text, "info string ");
+}
+
+// Sends as much of the output as possible without blocking. The rest is sent
+// by the server loop when the socket becomes writable again.
+void SessionHost::flush(Session& s) {
+
+    if (s.fd < 0)
+    {
+        sync_cout_start();
+        std::cout.write(s.output.data(), std::streamsize(s.output.size())) << std::flush;
+        sync_cout_end();
+    }
+
+#ifdef __linux__
+    else
+        while (s.outputSent < s.output.size())
+        {
+            const auto n = ::send(s.fd, s.output.data() + s.outputSent,
+                                  s.output.size() - s.outputSent, MSG_NOSIGNAL);
+
+            if (n < 0 && errno == EINTR)
+                continue;
+
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                if (!s.waitingWritable)
+                {
+                    epoll_event ev{};
+                    ev.events  = EPOLLIN | EPOLLOUT;
+                    ev.data.fd = s.fd;
+                    epoll_ctl(epollFd, EPOLL_CTL_MOD, s.fd, &ev);
+                    s.waitingWritable = true;
+                }
+                return;
+            }
+
+            if (n <= 0)
+                break;  // The client is gone, the server loop closes the session
+
+            s.outputSent += size_t(n);
+        }
+
+    if (s.waitingWritable)
+    {
+        epoll_event ev{};
+        ev.events  = EPOLLIN;
+        ev.data.fd = s.fd;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, s.fd, &ev);
+        s.waitingWritable = false;
+    }
+#endif
+
+    // Keeps the capacity, the buffer is reused for the next lines
+    s.output.clear();
+    s.outputSent = 0;
+}
+
+#ifdef __linux__
+
+std::optional<std::string> SessionHost::serve(const std::string& address) {
+
+    const bool tcp = !address.empty() && address.size() <= 5
+                  && std::all_of(address.begin(), address.end(), [](char c) {
+                         return std::isdigit(static_cast<unsigned char>(c));
+                     });
+
+    if (tcp && std::stoi(address) > 65535)
+        return "Invalid port " + address;
+
+    int listenFd = socket(tcp ? AF_INET : AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if (listenFd < 0)
+        return "Unable to create a socket";
+
+    int status;
+
+    if (tcp)
+    {
+        int one = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+        sockaddr_in addr{};
+        addr.sin_family      = AF_INET;
+        addr.sin_port        = htons(uint16_t(std::stoi(address)));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        status               = bind(listenFd, (sockaddr*) &addr, sizeof(addr));
+    }
+    else
+    {
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+
+        if (address.size() >= sizeof(addr.sun_path))
+        {
+            ::close(listenFd);
+            return "Socket path too long: " + address;
+        }
+
+        // A socket left by a previous server would make bind() fail
+        struct stat st;
+        if (stat(address.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+            unlink(address.c_str());
+
+        std::memcpy(addr.sun_path, address.c_str(), address.size() + 1);
+        status = bind(listenFd, (sockaddr*) &addr, sizeof(addr));
+    }
+
+    if (status < 0 || listen(listenFd, SOMAXCONN) < 0)
+    {
+        ::close(listenFd);
+        return "Unable to listen on " + address + ": " + std::strerror(errno);
+    }
+
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+
+    epoll_event ev{};
+    ev.events  = EPOLLIN;
+    ev.data.fd = listenFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev);
+    ev.data.fd = STDIN_FILENO;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, STDIN_FILENO, &ev);
+
+    sync_cout << "info string Listening on " << address << sync_endl;
+
+    constexpr int MaxEvents = 64;
+    epoll_event   events[MaxEvents];
+    uint64_t      clientCount = 0;
+    bool          quit        = false;
+    std::string   line;
+
+    while (!quit)
+    {
+        const int n = epoll_wait(epollFd, events, MaxEvents, -1);
+
+        for (int i = 0; i < n && !quit; ++i)
+        {
+            const int fd = events[i].data.fd;
+
+            if (fd == STDIN_FILENO)
+            {
+                if (!std::getline(std::cin, line))
+                    epoll_ctl(epollFd, EPOLL_CTL_DEL, STDIN_FILENO, nullptr);
+                else
+                    quit = line == "quit";
+            }
+
+            else if (fd == listenFd)
+                while (true)
+                {
+                    const int clientFd =
+                      accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+                    if (clientFd < 0)
+                        break;
+
+                    const std::string name = "client " + std::to_string(++clientCount);
+                    clients[clientFd]      = &session(name, clientFd);
+
+                    ev.data.fd = clientFd;
+                    epoll_ctl(epollFd, EPOLL_CTL_ADD, clientFd, &ev);
+                }
+
+            else
+            {
+                Session& s = *clients.at(fd);
+
+                if (events[i].events & EPOLLOUT)
+                {
+                    std::lock_guard<std::mutex> lk(s.outputMutex);
+                    flush(s);
+                }
+
+                if ((events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && !read_client(s))
+                {
+                    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+                    clients.erase(fd);
+                    close(s.name);
+                }
+            }
+        }
+    }
+
+    for (const auto& [fd, s] : clients)
+        close(s->name);
+
+    clients.clear();
+
+    // The searches still running may watch their socket with epoll until then
+    join_reaper();
+
+    ::close(epollFd);
+    ::close(listenFd);
+
+    if (!tcp)
+        unlink(address.c_str());
+
+    epollFd = -1;
+    return std::nullopt;
+}
+
+// Queues the complete lines received from the client, in order. Returns false
+// when the client is gone or has sent quit.
+bool SessionHost::read_client(Session& s) {
+
+    char buffer[4096];
+    bool open = true;
+
+    while (true)
+    {
+        const auto n = ::recv(s.fd, buffer, sizeof(buffer), 0);
+
+        if (n > 0)
+        {
+            s.input.append(buffer, size_t(n));
+            continue;
+        }
+
+        if (n < 0 && errno == EINTR)
+            continue;
+
+        open = n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+        break;
+    }
+
+    size_t begin = 0;
+
+    for (size_t end; (end = s.input.find('\n', begin)) != std::string::npos; begin = end + 1)
+    {
+        std::string cmd = s.input.substr(begin, end - begin);
+
+        if (!cmd.empty() && cmd.back() == '\r')
+            cmd.pop_back();
+
+        if (cmd == "quit")
+            return false;
+
+        if (!is_whitespace(cmd))
+            post(s, cmd);
+    }
+
+    s.input.erase(0, begin);
+    return open;
+}
+
+#else
+
+std::optional<std::string> SessionHost::serve(const std::string&) {
+    return "The server mode is only available on Linux";
+}
+
+bool SessionHost::read_client(Session&) { return false; }
+
+#endif
+
+}  // namespace Stockfish
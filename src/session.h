@@ -0,0 +1,168 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2026 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SESSION_H_INCLUDED
+#define SESSION_H_INCLUDED
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "engine.h"
+#include "search.h"
+
+namespace Stockfish {
+
+// Shares a budget of search threads between the sessions of a SessionHost.
+// A search is charged the Threads option of its session while it runs. A search
+// that does not fit waits in FIFO order, so that a session with many threads
+// cannot be starved by smaller ones.
+class SessionScheduler {
+   public:
+    explicit SessionScheduler(size_t budget) :
+        threadBudget(budget) {}
+
+    size_t budget() const { return threadBudget; }
+    size_t in_use() const { return threadsInUse; }
+
+    bool fits(size_t threads) const { return threadsInUse + threads <= threadBudget; }
+    void acquire(size_t threads) { threadsInUse += threads; }
+    void release(size_t threads) { threadsInUse -= threads; }
+
+   private:
+    size_t threadBudget;
+    size_t threadsInUse = 0;
+};
+
+// SessionHost multiplexes independent UCI sessions over the standard input and
+// output of one process. Every input line starts with a session name followed
+// by a UCI command, and every output line starts with the name of the session
+// it belongs to. A session is created by its first command and closed by its
+// own quit command, a bare quit closes all of them.
+//
+// In server mode every client connection is a session of its own, and the
+// lines carry no session name.
+//
+// A command that waits for the search of its session, like setoption during a
+// search, runs on a thread of the session instead, with the commands received
+// after it, so that it does not hold up the input of the other sessions. stop
+// and ponderhit still act at once on the running search. quit drops the
+// commands of the session not run yet.
+//
+// Each session has its own Engine, thus its own position, options, thread pool
+// and transposition table. The networks are not loaded again per session: equal
+// networks are deduplicated in system-wide shared memory, so all the sessions
+// evaluate with the same replica.
+class SessionHost {
+   public:
+    SessionHost(std::string binaryPath, size_t threadBudget);
+    ~SessionHost();
+
+    // Reads the commands of all the sessions from the standard input
+    void loop();
+
+    // Serves the clients of a Unix domain socket, or of a TCP port of the
+    // loopback interface if the address is a number, until quit is read from
+    // the standard input. Returns an error message on failure.
+    std::optional<std::string> serve(const std::string& address);
+
+   private:
+    struct Session {
+        Session(const std::string& name, const std::string& binaryPath, int fd);
+
+        std::string                       name;
+        Engine                            engine;
+        std::optional<Search::LimitsType> waitingSearch;  // Queued until threads are free
+        size_t                            searchThreads = 0;
+
+        // Client socket, or -1 when the output goes to stdout after the name
+        int         fd;
+        std::string input;  // Received bytes not yet forming a full line
+
+        // Commands queued for the command thread, not run yet
+        std::mutex              commandMutex;
+        std::condition_variable commandCv;
+        std::deque<std::string> commands;
+        bool                    closing = false, busy = false;
+        std::thread             commandThread;
+
+        // Output not sent yet, preallocated so that the info lines of a search
+        // are appended without allocating. Written by the search threads.
+        std::mutex  outputMutex;
+        std::string output;
+        size_t      outputSent      = 0;
+        bool        waitingWritable = false;
+    };
+
+    Session& session(const std::string& name, int fd = -1);
+    void     post(Session& s, const std::string& cmd);
+    void     run_commands(Session& s);
+    void     execute(Session& s, const std::string& cmd);
+    void     go(Session& s, std::istringstream& is);
+    void     stop(Session& s);
+    void     setoption(Session& s, std::istringstream& is);
+    void     close(const std::string& name);
+    void     cancel_search(Session& s);
+    void     reap();
+    void     join_reaper();
+
+    // Called with the mutex held
+    void dispatch();
+    void start_search(Session& s);
+    void finish_search(Session& s, const std::string& bestmove);
+
+    void print(Session& s, std::string_view text, std::string_view linePrefix = {});
+    void print_line(Session& s, std::string_view line);
+    void print_info_string(Session& s, std::string_view text);
+
+    // Called with the output mutex held
+    void append_line(Session& s, std::string_view line, std::string_view linePrefix);
+    void flush(Session& s);
+
+    bool read_client(Session& s);
+
+    const std::string                               binaryPath;
+    std::map<std::string, std::unique_ptr<Session>> sessions;
+    std::map<int, Session*>                         clients;
+    int                                             epollFd = -1;
+
+    // Closed sessions, torn down by the reaper thread so that waiting for their
+    // search and commands does not hold up the input of the other sessions
+    std::mutex                           reapMutex;
+    std::condition_variable              reapCv;
+    std::deque<std::unique_ptr<Session>> closed;
+    bool                                 stopReaper = false;
+    std::thread                          reaper;
+
+    // Guards the scheduler and the search state of the sessions
+    std::mutex           mutex;
+    SessionScheduler     scheduler;
+    std::deque<Session*> queue;
+};
+
+}  // namespace Stockfish
+
+#endif  // #ifndef SESSION_H_INCLUDED
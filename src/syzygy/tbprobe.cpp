@@ -21,6 +21,8 @@
 #include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
@@ -32,6 +34,7 @@
 #include <sstream>
 #include <string_view>
 #include <sys/stat.h>
+#include <thread>
 #include <type_traits>
 #include <utility>
 #include <vector>
@@ -151,6 +154,19 @@ int sign_of(T val) {
     return (T(0) < val) - (val < T(0));
 }
 
+// Returns the pieces of the position as a file name like "KRvK", the pieces of
+// the given color first.
+std::string material_code(const Position& pos, Color first) {
+
+    std::string sides[COLOR_NB];
+
+    for (Color c : {WHITE, BLACK})
+        for (PieceType pt = KING; pt >= PAWN; --pt)
+            sides[c] += std::string(popcount(pos.pieces(c, pt)), PieceToChar[pt]);
+
+    return sides[first] + 'v' + sides[~first];
+}
+
 // Numbers in little-endian used by sparseIndex[] to point into blockLength[]
 struct SparseEntry {
     char block[4];   // Number of block
@@ -357,6 +373,7 @@ struct TBTable {
     void*            baseAddress;
     uint8_t*         map;
     uint64_t         mapping;
+    std::string      name;  // File name without extension, like "KRvK"
     Key              key;
     Key              key2;
     int              pieceCount;
@@ -388,6 +405,7 @@ TBTable<WDL>::TBTable(const std::string& code) :
 
     key        = pos.set(code, WHITE, &st).material_key();
     pieceCount = pos.count<ALL_PIECES>();
+    name       = material_code(pos, WHITE);
     hasPawns   = pos.pieces(PAWN);
 
     hasUniquePieces = false;
@@ -412,6 +430,7 @@ TBTable<DTZ>::TBTable(const TBTable<WDL>& wdl) :
     TBTable() {
 
     // Use the corresponding WDL table to avoid recalculating all from scratch
+    name            = wdl.name;
     key             = wdl.key;
     key2            = wdl.key2;
     pieceCount      = wdl.pieceCount;
@@ -499,6 +518,14 @@ class TBTables {
     }
 
     void add(const std::vector<PieceType>& pieces);
+
+    // Calls f on the WDL and DTZ tables with at most the given number of pieces
+    template<typename F>
+    void for_each(int maxPieces, F f) {
+        for (size_t i = 0; i < wdlTable.size(); ++i)
+            if (wdlTable[i].pieceCount <= maxPieces)
+                f(wdlTable[i], dtzTable[i]);
+    }
 };
 
 TBTables TBTables;
@@ -1212,16 +1239,20 @@ void set(T& e, uint8_t* data) {
         }
 }
 
+// Tables mapped by a probing thread instead of the prefetcher, and probes slow
+// enough to have waited for I/O. Both are reported by Tablebases::stall_stats().
+std::atomic<uint64_t> MapStalls{0}, SlowProbes{0};
+
+constexpr auto SlowProbeTime = std::chrono::milliseconds(1);
+
 // If the TB file corresponding to the given position is already memory-mapped
 // then return its base address, otherwise, try to memory map and init it. Called
 // at every probe, memory map, and init only at first access. Function is thread
 // safe and can be called concurrently.
 template<TBType Type>
-void* mapped(TBTable<Type>& e, const Position& pos) {
+void* mapped(TBTable<Type>& e, bool prefetching = false) {
 
     static std::mutex mutex;
-    // Because TB is the only usage of materialKey, check it here in debug mode
-    assert(pos.material_key_is_ok());
 
     // Use 'acquire' to avoid a thread reading 'ready' == true while
     // another is still working. (compiler reordering may cause this).
@@ -1233,16 +1264,10 @@ void* mapped(TBTable<Type>& e, const Position& pos) {
     if (e.ready.load(std::memory_order_relaxed))  // Recheck under lock
         return e.baseAddress;
 
-    // Pieces strings in decreasing order for each color, like ("KPP","KR")
-    std::string fname, w, b;
-    for (PieceType pt = KING; pt >= PAWN; --pt)
-    {
-        w += std::string(popcount(pos.pieces(WHITE, pt)), PieceToChar[pt]);
-        b += std::string(popcount(pos.pieces(BLACK, pt)), PieceToChar[pt]);
-    }
+    if (!prefetching)
+        MapStalls.fetch_add(1, std::memory_order_relaxed);
 
-    fname =
-      (e.key == pos.material_key() ? w + 'v' + b : b + 'v' + w) + (Type == WDL ? ".rtbw" : ".rtbz");
+    const std::string fname = e.name + (Type == WDL ? ".rtbw" : ".rtbz");
 
     uint8_t* data = TBFile(fname).map(&e.baseAddress, &e.mapping, Type);
 
@@ -1253,18 +1278,298 @@ void* mapped(TBTable<Type>& e, const Position& pos) {
     return e.baseAddress;
 }
 
+// Maps tables and asks the OS to read them ahead from a background thread, so
+// that the search threads do not stall on page faults when they first probe
+// them. Tables are queued by piece count when warming up after init, and
+// during the search for the materials one capture away from the probed range.
+class Prefetcher {
+
+    struct Job {
+        TBTable<WDL>* wdl;
+        TBTable<DTZ>* dtz;
+        std::string   code;  // Prefetch the WDL tables one capture away from this material
+    };
+
+   public:
+    ~Prefetcher() {
+
+        {
+            std::scoped_lock<std::mutex> lk(mutex);
+            exit = true;
+        }
+
+        cv.notify_all();
+
+        if (thread.joinable())
+            thread.join();
+    }
+
+    void warm_up(int maxPieces) {
+
+        std::unique_lock<std::mutex> lk(mutex);
+
+        TBTables.for_each(maxPieces, [&](TBTable<WDL>& wdl, TBTable<DTZ>& dtz) {
+            queue.push_back({&wdl, &dtz, ""});
+        });
+
+        start(lk);
+    }
+
+    // Called by the search threads, so it never blocks
+    void request(const Position& pos) {
+
+        const Key key  = pos.material_key();
+        auto&     slot = requested[key & (requested.size() - 1)];
+
+        if (slot.load(std::memory_order_relaxed) == key)
+            return;
+
+        std::unique_lock<std::mutex> lk(mutex, std::try_to_lock);
+
+        if (!lk.owns_lock())
+            return;
+
+        slot.store(key, std::memory_order_relaxed);
+        queue.push_back({nullptr, nullptr, material_code(pos, WHITE)});
+        start(lk);
+    }
+
+    // Drops the pending jobs and waits for the running one, the tables are
+    // about to be destroyed.
+    void clear() {
+
+        std::unique_lock<std::mutex> lk(mutex);
+
+        queue.clear();
+        cv.wait(lk, [&] { return !busy; });
+
+        for (auto& slot : requested)
+            slot.store(0, std::memory_order_relaxed);
+    }
+
+   private:
+    void start(std::unique_lock<std::mutex>& lk) {
+
+        if (!thread.joinable())
+            thread = std::thread(&Prefetcher::idle_loop, this);
+
+        lk.unlock();
+        cv.notify_all();
+    }
+
+    void idle_loop() {
+
+        std::unique_lock<std::mutex> lk(mutex);
+
+        while (true)
+        {
+            cv.wait(lk, [&] { return exit || !queue.empty(); });
+
+            if (exit)
+                return;
+
+            Job job = std::move(queue.front());
+            queue.pop_front();
+            busy = true;
+
+            lk.unlock();
+            run(job);
+            lk.lock();
+
+            busy = false;
+            cv.notify_all();
+        }
+    }
+
+    void run(const Job& job) {
+
+        if (job.wdl)
+        {
+            prefetch(*job.wdl);
+            prefetch(*job.dtz);
+            return;
+        }
+
+        // Remove in turn each piece but the kings from the material "KRPvKR"
+        for (size_t i = 1; i < job.code.size(); ++i)
+        {
+            if (job.code[i] == 'K' || job.code[i] == 'v' || job.code[i] == job.code[i - 1])
+                continue;
+
+            StateInfo   st;
+            Position    pos;
+            std::string code = job.code;
+            code.erase(i, 1);
+
+            if (TBTable<WDL>* e = TBTables.get<WDL>(pos.set(code, WHITE, &st).material_key()))
+                prefetch(*e);
+        }
+    }
+
+    template<TBType Type>
+    void prefetch(TBTable<Type>& e) {
+
+        if (!mapped(e, true))
+            return;
+
+#if !defined(_WIN32) && defined(MADV_WILLNEED)
+        madvise(e.baseAddress, e.mapping, MADV_WILLNEED);
+#endif
+    }
+
+    std::mutex              mutex;
+    std::condition_variable cv;
+    std::deque<Job>         queue;
+    bool                    exit = false, busy = false;
+    std::thread             thread;
+
+    // Materials already queued by the search, so that they are queued only once
+    std::array<std::atomic<Key>, 1024> requested{};
+};
+
+Prefetcher Prefetcher;
+
+// The search probes the same endgame positions over and over, and every probe
+// decompresses a block of the table. So the results of probe_table() are kept
+// in a small direct-mapped cache per thread, sized by the "SyzygyCacheSize"
+// option and emptied whenever the tables are reloaded.
+class ProbeCache {
+
+    struct Entry {
+        Key     key;
+        int32_t value;
+        int8_t  wdl;  // A DTZ value depends on the WDL score it was probed with
+        int8_t  type;
+        bool    used;
+        bool    changeStm;
+    };
+
+   public:
+    ProbeCache() {
+        std::scoped_lock<std::mutex> lk(registryMutex);
+        registry.push_back(this);
+    }
+
+    ~ProbeCache() {
+        std::scoped_lock<std::mutex> lk(registryMutex);
+        registry.erase(std::find(registry.begin(), registry.end(), this));
+        retiredHits += hits;
+        retiredProbes += probes;
+    }
+
+    // Returns the cache of the calling thread, emptied if it is stale
+    static ProbeCache& get() {
+
+        thread_local ProbeCache cache;
+
+        if (cache.generation != Generation.load(std::memory_order_relaxed))
+        {
+            cache.generation = Generation.load(std::memory_order_relaxed);
+            cache.entries.assign(EntryCount.load(std::memory_order_relaxed), Entry{});
+        }
+
+        return cache;
+    }
+
+    static void resize(size_t count) {
+        EntryCount = count;
+        ++Generation;
+    }
+
+    static void clear() { ++Generation; }
+
+    static CacheStats stats() {
+        std::scoped_lock<std::mutex> lk(registryMutex);
+
+        CacheStats s{retiredHits, retiredProbes};
+
+        for (const ProbeCache* cache : registry)
+        {
+            s.hits += cache->hits.load(std::memory_order_relaxed);
+            s.probes += cache->probes.load(std::memory_order_relaxed);
+        }
+
+        return s;
+    }
+
+    template<TBType Type>
+    bool probe(Key key, WDLScore wdl, int& value, bool& changeStm) {
+
+        if (entries.empty())
+            return false;
+
+        // Only the thread owning the cache writes its counters
+        probes.store(probes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+        const Entry& e = entries[mul_hi64(key, entries.size())];
+
+        if (!e.used || e.key != key || e.type != Type || (Type == DTZ && e.wdl != wdl))
+            return false;
+
+        hits.store(hits.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        value     = e.value;
+        changeStm = e.changeStm;
+        return true;
+    }
+
+    template<TBType Type>
+    void store(Key key, WDLScore wdl, int value, bool changeStm) {
+
+        if (!entries.empty())
+            entries[mul_hi64(key, entries.size())] = {key, int32_t(value), int8_t(wdl),
+                                                      int8_t(Type), true, changeStm};
+    }
+
+    static constexpr size_t EntrySize = sizeof(Entry);
+
+   private:
+    static inline std::atomic<size_t> EntryCount{0};
+    static inline std::atomic<size_t> Generation{1};
+
+    static inline std::mutex               registryMutex;
+    static inline std::vector<ProbeCache*> registry;
+    static inline uint64_t                 retiredHits = 0, retiredProbes = 0;
+
+    std::vector<Entry>    entries;
+    size_t                generation = 0;
+    std::atomic<uint64_t> hits{0}, probes{0};
+};
+
 template<TBType Type, typename Ret = typename TBTable<Type>::Ret>
 Ret probe_table(const Position& pos, ProbeState* result, WDLScore wdl = WDLDraw) {
 
     if (pos.count<ALL_PIECES>() == 2)  // KvK
         return Ret(WDLDraw);
 
+    ProbeCache& cache = ProbeCache::get();
+    int         cachedValue;
+    bool        changeStm;
+
+    if (cache.probe<Type>(pos.key(), wdl, cachedValue, changeStm))
+    {
+        if (changeStm)
+            *result = CHANGE_STM;
+
+        return Ret(cachedValue);
+    }
+
+    // Because TB is the only usage of materialKey, check it here in debug mode
+    assert(pos.material_key_is_ok());
+
     TBTable<Type>* entry = TBTables.get<Type>(pos.material_key());
 
-    if (!entry || !mapped(*entry, pos))
+    if (!entry || !mapped(*entry))
         return *result = FAIL, Ret();
 
-    return do_probe_table(pos, entry, wdl, result);
+    const auto       start  = std::chrono::steady_clock::now();
+    const ProbeState before = *result;
+    const Ret        value  = do_probe_table(pos, entry, wdl, result);
+
+    if (std::chrono::steady_clock::now() - start > SlowProbeTime)
+        SlowProbes.fetch_add(1, std::memory_order_relaxed);
+
+    cache.store<Type>(pos.key(), wdl, int(value), *result == CHANGE_STM && before != CHANGE_STM);
+    return value;
 }
 
 // For a position where the side to move has a winning capture it is not necessary
@@ -1348,7 +1653,9 @@ WDLScore search(Position& pos, ProbeState* result) {
 // safe, nor it needs to be.
 void Tablebases::init(const std::string& paths) {
 
+    Prefetcher.clear();
     TBTables.clear();
+    ProbeCache::clear();
     MaxCardinality = 0;
     TBFile::Paths  = paths;
 
@@ -1495,6 +1802,27 @@ void Tablebases::init(const std::string& paths) {
     TBTables.info();
 }
 
+// Sets the size in KiB of the probe cache of each thread, 0 disables it
+void Tablebases::set_cache_size(size_t kbPerThread) {
+    ProbeCache::resize(kbPerThread * 1024 / ProbeCache::EntrySize);
+}
+
+CacheStats Tablebases::cache_stats() { return ProbeCache::stats(); }
+
+// Maps the tables with up to the given number of pieces in the background and
+// asks the OS to read them ahead, 0 does nothing.
+void Tablebases::warm_up(int maxPieces) {
+    if (maxPieces > 0)
+        Prefetcher.warm_up(maxPieces);
+}
+
+// Called by the search for positions one capture away from the probed tables
+void Tablebases::prefetch(const Position& pos) { Prefetcher.request(pos); }
+
+StallStats Tablebases::stall_stats() {
+    return {MapStalls.load(std::memory_order_relaxed), SlowProbes.load(std::memory_order_relaxed)};
+}
+
 // Probe the WDL table for a particular position.
 // If *result != FAIL, the probe was successful.
 // The return value is from the point of view of the side to move:
@@ -1728,6 +2056,7 @@ Config Tablebases::rank_root_moves(const OptionsMap&            options,
     config.useRule50   = bool(options["Syzygy50MoveRule"]);
     config.probeDepth  = int(options["SyzygyProbeDepth"]);
     config.cardinality = int(options["SyzygyProbeLimit"]);
+    config.prefetch    = bool(options["SyzygyPrefetch"]);
 
     bool dtz_available = true;
 
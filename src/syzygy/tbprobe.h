@@ -19,6 +19,8 @@
 #ifndef TBPROBE_H
 #define TBPROBE_H
 
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <string>
 #include <vector>
@@ -43,6 +45,7 @@ struct Config {
     bool  rootInTB    = false;
     bool  useRule50   = false;
     Depth probeDepth  = 0;
+    bool  prefetch    = false;
 };
 
 enum WDLScore {
@@ -61,19 +64,36 @@ enum ProbeState {
     ZEROING_BEST_MOVE = 2    // Best move zeroes DTZ (capture or pawn move)
 };
 
+// Hits of the per thread probe caches, summed over all threads
+struct CacheStats {
+    uint64_t hits;
+    uint64_t probes;
+};
+
+// Tables mapped by a probing thread, and probes that waited more than 1 ms
+struct StallStats {
+    uint64_t lazyMaps;
+    uint64_t slowProbes;
+};
+
 extern int MaxCardinality;
 
 
-void     init(const std::string& paths);
-WDLScore probe_wdl(Position& pos, ProbeState* result);
-int      probe_dtz(Position& pos, ProbeState* result);
-bool     root_probe(Position&                    pos,
-                    Search::RootMoves&           rootMoves,
-                    bool                         rule50,
-                    bool                         rankDTZ,
-                    const std::function<bool()>& time_abort);
-bool     root_probe_wdl(Position& pos, Search::RootMoves& rootMoves, bool rule50);
-Config   rank_root_moves(
+void       init(const std::string& paths);
+void       set_cache_size(size_t kbPerThread);
+CacheStats cache_stats();
+void       warm_up(int maxPieces);
+void       prefetch(const Position& pos);
+StallStats stall_stats();
+WDLScore   probe_wdl(Position& pos, ProbeState* result);
+int        probe_dtz(Position& pos, ProbeState* result);
+bool       root_probe(Position&                    pos,
+                      Search::RootMoves&           rootMoves,
+                      bool                         rule50,
+                      bool                         rankDTZ,
+                      const std::function<bool()>& time_abort);
+bool       root_probe_wdl(Position& pos, Search::RootMoves& rootMoves, bool rule50);
+Config     rank_root_moves(
     const OptionsMap&            options,
     Position&                    pos,
     Search::RootMoves&           rootMoves,
@@ -0,0 +1,344 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2026 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "telemetry.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <utility>
+
+#ifndef _WIN32
+    #include <sys/socket.h>
+    #include <sys/stat.h>
+    #include <sys/un.h>
+    #include <unistd.h>
+#endif
+
+namespace Stockfish {
+
+namespace {
+
+#if defined(MSG_NOSIGNAL)
+constexpr int SendFlags = MSG_NOSIGNAL;  // A closed peer must not raise SIGPIPE
+#else
+constexpr int SendFlags = 0;
+#endif
+
+const std::string CSVHeader =
+  "search,time_ms,nodes,nps,tbhits,hashfull,depth,seldepth,best_move_changes\n";
+
+std::string to_csv(const TelemetrySample& s) {
+    std::stringstream ss;
+    ss << s.search << ',' << s.time << ',' << s.nodes << ',' << s.nps << ',' << s.tbHits << ','
+       << s.hashfull << ',' << s.depth << ',' << s.selDepth << ',' << s.bestMoveChanges << '\n';
+    return ss.str();
+}
+
+std::string to_prometheus(const TelemetrySample& s) {
+    std::stringstream ss;
+
+    auto gauge = [&](const char* name, const char* help, auto value) {
+        ss << "# HELP stockfish_" << name << ' ' << help << "\n# TYPE stockfish_" << name
+           << " gauge\nstockfish_" << name << ' ' << value << '\n';
+    };
+
+    gauge("search", "Sequence number of the current search.", s.search);
+    gauge("search_time_ms", "Time elapsed since the search started.", s.time);
+    gauge("nodes", "Nodes searched by all threads.", s.nodes);
+    gauge("nps", "Nodes searched per second.", s.nps);
+    gauge("tbhits", "Successful tablebase probes.", s.tbHits);
+    gauge("hashfull", "Transposition table usage in permill.", s.hashfull);
+    gauge("depth", "Depth of the last PV sent.", s.depth);
+    gauge("seldepth", "Selective depth of the last PV sent.", s.selDepth);
+    gauge("best_move_changes", "Best move changes in the current iteration.",
+          s.bestMoveChanges);
+    return ss.str();
+}
+
+}  // namespace
+
+TelemetryExporter::TelemetryExporter(Sampler s) :
+    sampler(std::move(s)) {}
+
+TelemetryExporter::~TelemetryExporter() {
+
+    {
+        std::lock_guard<std::mutex> lk(mutex);
+        exit = true;
+    }
+
+    cv.notify_one();
+
+    if (thread.joinable())
+        thread.join();
+
+    close();
+}
+
+std::optional<std::string>
+TelemetryExporter::open(const std::string& newPath, Format newFormat, int intervalMs) {
+
+    std::lock_guard<std::mutex> sinkLock(sinkMutex);
+
+    // Only the interval changed, keep the sink and the samples written so far
+    if (newPath == path && newFormat == format)
+    {
+        std::lock_guard<std::mutex> lk(mutex);
+        interval = intervalMs;
+        return std::nullopt;
+    }
+
+    close();
+    path   = newPath;
+    format = newFormat;
+
+    {
+        std::lock_guard<std::mutex> lk(mutex);
+        interval = intervalMs;
+        enabled  = !path.empty();
+    }
+
+    if (path.empty())
+        return std::nullopt;
+
+    std::optional<std::string> error;
+
+#ifndef _WIN32
+    struct stat st;
+
+    if (stat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+    {
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+
+        if (path.size() >= sizeof(addr.sun_path))
+            error = "Telemetry socket path too long: " + path;
+        else
+        {
+            std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+            socketFd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    #if defined(SO_NOSIGPIPE)
+            int one = 1;
+            if (socketFd >= 0)
+                setsockopt(socketFd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+    #endif
+
+            if (socketFd < 0 || connect(socketFd, (sockaddr*) &addr, sizeof(addr)) < 0)
+                error = "Unable to connect to telemetry socket " + path;
+
+            else if (format == Format::CSV && !send(CSVHeader))
+                error = "Unable to write to telemetry socket " + path;
+        }
+    }
+    else
+#endif
+    {
+        // A Prometheus file is rewritten with every sample, start with an empty
+        // one. CSV rows are appended to the history already in the file.
+        file.open(path, format == Format::CSV ? std::ios::out | std::ios::app
+                                              : std::ios::out | std::ios::trunc);
+
+        if (!file.is_open())
+            error = "Unable to open telemetry file " + path;
+
+        else if (format == Format::CSV)
+        {
+            if (file.seekp(0, std::ios::end).tellp() == 0)
+                file << CSVHeader << std::flush;
+        }
+        else
+            file.close();
+    }
+
+    if (error)
+    {
+        close();
+        path.clear();
+
+        std::lock_guard<std::mutex> lk(mutex);
+        enabled = false;
+        return error;
+    }
+
+    if (!thread.joinable())
+        thread = std::thread(&TelemetryExporter::idle_loop, this);
+
+    return std::nullopt;
+}
+
+void TelemetryExporter::search_started() {
+
+    {
+        std::lock_guard<std::mutex> lk(mutex);
+
+        if (!enabled)
+            return;
+
+        ++searchCount;
+        startTime = now();
+        depth     = selDepth = 0;
+        searching = true;
+    }
+
+    cv.notify_one();
+}
+
+void TelemetryExporter::search_finished() {
+
+    {
+        std::lock_guard<std::mutex> lk(mutex);
+
+        if (!searching)
+            return;
+
+        finalSample = take_sample();
+        searching   = false;
+    }
+
+    cv.notify_one();
+}
+
+void TelemetryExporter::update_depth(int d, int sd) {
+    depth.store(d, std::memory_order_relaxed);
+    selDepth.store(sd, std::memory_order_relaxed);
+}
+
+// Must be called with the mutex held and a search running, so that the thread
+// pool cannot be resized under the sampler.
+TelemetrySample TelemetryExporter::take_sample() {
+
+    TelemetrySample s;
+    static_cast<TelemetryCounters&>(s) = sampler();
+
+    s.search   = searchCount;
+    s.time     = now() - startTime;
+    s.nps      = s.nodes * 1000 / std::max(s.time, TimePoint(1));
+    s.depth    = depth.load(std::memory_order_relaxed);
+    s.selDepth = selDepth.load(std::memory_order_relaxed);
+    return s;
+}
+
+void TelemetryExporter::idle_loop() {
+
+    std::unique_lock<std::mutex> lk(mutex);
+
+    while (true)
+    {
+        if (finalSample)
+        {
+            TelemetrySample s = *finalSample;
+            finalSample.reset();
+
+            lk.unlock();
+            write(s);
+            lk.lock();
+            continue;
+        }
+
+        if (exit)
+            break;
+
+        if (!searching)
+        {
+            cv.wait(lk, [&] { return exit || searching || finalSample; });
+            continue;
+        }
+
+        // Sample at the end of each interval, unless the search finished meanwhile
+        if (cv.wait_for(lk, std::chrono::milliseconds(interval),
+                        [&] { return exit || !searching || finalSample; }))
+            continue;
+
+        TelemetrySample s = take_sample();
+
+        lk.unlock();
+        write(s);
+        lk.lock();
+    }
+}
+
+void TelemetryExporter::write(const TelemetrySample& s) {
+
+    std::lock_guard<std::mutex> lk(sinkMutex);
+
+    if (path.empty())
+        return;
+
+    const std::string text = format == Format::CSV ? to_csv(s) : to_prometheus(s);
+
+    if (socketFd >= 0)
+    {
+        if (!send(text))
+        {
+            sync_cout << "info string ERROR: Telemetry socket " << path << " was closed"
+                      << sync_endl;
+            close();
+            path.clear();
+        }
+    }
+    else if (format == Format::CSV)
+        file << text << std::flush;
+
+    else
+    {
+        // Replace the file atomically, a scraper must never read a partial sample
+        const std::string tmp = path + ".tmp";
+        std::ofstream(tmp, std::ios::out | std::ios::trunc) << text;
+        std::rename(tmp.c_str(), path.c_str());
+    }
+}
+
+bool TelemetryExporter::send(const std::string& text) {
+
+#ifndef _WIN32
+    for (size_t done = 0; done < text.size();)
+    {
+        const auto n = ::send(socketFd, text.data() + done, text.size() - done, SendFlags);
+
+        if (n <= 0)
+            return false;
+
+        done += size_t(n);
+    }
+
+    return true;
+#else
+    (void) text;
+    return false;
+#endif
+}
+
+void TelemetryExporter::close() {
+
+#ifndef _WIN32
+    if (socketFd >= 0)
+        ::close(socketFd);
+#endif
+
+    socketFd = -1;
+
+    if (file.is_open())
+        file.close();
+}
+
+}  // namespace Stockfish
@@ -0,0 +1,115 @@
+/*
+  Stockfish, a UCI chess playing engine derived from Glaurung 2.1
+  Copyright (C) 2004-2026 The Stockfish developers (see AUTHORS file)
+
+  Stockfish is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Stockfish is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TELEMETRY_H_INCLUDED
+#define TELEMETRY_H_INCLUDED
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+#include "misc.h"
+
+namespace Stockfish {
+
+// Values read from the thread pool and the transposition table for each sample
+struct TelemetryCounters {
+    uint64_t nodes;
+    uint64_t tbHits;
+    uint64_t bestMoveChanges;
+    int      hashfull;
+};
+
+struct TelemetrySample: TelemetryCounters {
+    uint64_t  search;  // Sequence number of the search, starting at 1
+    TimePoint time;    // Milliseconds since the search was started
+    uint64_t  nps;
+    int       depth;
+    int       selDepth;
+};
+
+// TelemetryExporter samples the progress of every search at a fixed interval
+// from a background thread. The samples are written in Prometheus text
+// exposition format or as CSV, either to a file or to a listening Unix domain
+// socket. A Prometheus file only ever holds the latest sample, and is replaced
+// atomically so that a scraper never reads a partial one. CSV rows are appended,
+// also to the rows left in the file by a previous run.
+class TelemetryExporter {
+   public:
+    enum class Format {
+        Prometheus,
+        CSV
+    };
+
+    using Sampler = std::function<TelemetryCounters()>;
+
+    // The sampler is only called while a search is running
+    explicit TelemetryExporter(Sampler);
+    ~TelemetryExporter();
+
+    // Redirects the samples to the given file or socket, an empty path disables
+    // the exporter. The sink is kept if only the interval changes. Returns an
+    // error message on failure.
+    std::optional<std::string> open(const std::string& path, Format format, int intervalMs);
+
+    // Called by the engine around every search, the last sample being taken
+    // when the search has finished, before the best move is sent.
+    void search_started();
+    void search_finished();
+
+    // Called from the main search thread with the depths of each new PV
+    void update_depth(int depth, int selDepth);
+
+   private:
+    void            idle_loop();
+    TelemetrySample take_sample();
+    void            write(const TelemetrySample& sample);
+    bool            send(const std::string& text);
+    void            close();
+
+    Sampler sampler;
+
+    // Guards the search state below, the sampler is called with it held
+    std::mutex                     mutex;
+    std::condition_variable        cv;
+    bool                           exit = false, enabled = false, searching = false;
+    int                            interval    = 1000;
+    uint64_t                       searchCount = 0;
+    TimePoint                      startTime   = 0;
+    std::optional<TelemetrySample> finalSample;
+    std::atomic<int>               depth{0}, selDepth{0};
+
+    // Guards the output, which is written by the background thread
+    std::mutex    sinkMutex;
+    std::string   path;
+    Format        format   = Format::Prometheus;
+    int           socketFd = -1;
+    std::ofstream file;
+
+    std::thread thread;
+};
+
+}  // namespace Stockfish
+
+#endif  // #ifndef TELEMETRY_H_INCLUDED
@@ -19,10 +19,13 @@
 #include "thread.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <deque>
 #include <map>
 #include <memory>
+#include <numeric>
 #include <string>
 #include <unordered_map>
 #include <utility>
@@ -34,12 +37,54 @@
 #include "search.h"
 #include "syzygy/tbprobe.h"
 #include "timeman.h"
+#include "tt.h"
 #include "types.h"
 #include "uci.h"
 #include "ucioption.h"
 
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    #include <intrin.h>
+#endif
+
 namespace Stockfish {
 
+namespace {
+
+// Hints the CPU that we are busy waiting, which saves power and leaves the
+// execution units to the other hardware thread of the core.
+inline void spin_pause() {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    _mm_pause();
+#elif defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+// The legal moves of the position listed in the "searchmoves" limit, or all of them
+Search::RootMoves root_moves(Position& pos, const Search::LimitsType& limits) {
+
+    Search::RootMoves rootMoves;
+    const auto        legalmoves = MoveList<LEGAL>(pos);
+
+    for (const auto& uciMove : limits.searchmoves)
+    {
+        auto move = UCIEngine::to_move(pos, uciMove);
+
+        if (std::find(legalmoves.begin(), legalmoves.end(), move) != legalmoves.end())
+            rootMoves.emplace_back(move);
+    }
+
+    if (rootMoves.empty())
+        for (const auto& m : legalmoves)
+            rootMoves.emplace_back(m);
+
+    return rootMoves;
+}
+
+}  // namespace
+
 // Constructor launches the thread and waits until it goes to sleep
 // in idle_loop(). Note that 'searching' and 'exit' should be already set.
 Thread::Thread(Search::SharedState&                    sharedState,
@@ -80,10 +125,16 @@ Thread::~Thread() {
     stdThread.join();
 }
 
-// Wakes up the thread that will start the search
-void Thread::start_searching() {
+// Wakes up the thread that will start the search, or only prepares it
+// to be started with start_job().
+void Thread::start_searching(bool start) {
     assert(worker != nullptr);
-    run_custom_job([this]() { worker->start_searching(); });
+    run_custom_job(
+      [this]() {
+          searchStartTime.store(std::chrono::steady_clock::now(), std::memory_order_relaxed);
+          worker->start_searching();
+      },
+      start);
 }
 
 // Clears the histories for the thread worker (usually before a new game)
@@ -99,13 +150,27 @@ void Thread::wait_for_search_finished() {
     cv.wait(lk, [&] { return !searching; });
 }
 
-// Launching a function in the thread
-void Thread::run_custom_job(std::function<void()> f) {
+// Launching a function in the thread. When start is false the function only
+// runs after start_job() is called, but the thread counts as searching already.
+void Thread::run_custom_job(std::function<void()> f, bool start) {
     {
         std::unique_lock<std::mutex> lk(mutex);
         cv.wait(lk, [&] { return !searching; });
         jobFunc   = std::move(f);
         searching = true;
+
+        if (!start)
+            return;
+
+        jobStarted.store(true, std::memory_order_release);
+    }
+    cv.notify_one();
+}
+
+void Thread::start_job() {
+    {
+        std::scoped_lock<std::mutex> lk(mutex);
+        jobStarted.store(true, std::memory_order_release);
     }
     cv.notify_one();
 }
@@ -121,7 +186,28 @@ void Thread::idle_loop() {
         std::unique_lock<std::mutex> lk(mutex);
         searching = false;
         cv.notify_one();  // Wake up anyone waiting for search finished
-        cv.wait(lk, [&] { return searching; });
+
+        // Busy wait for a while before parking, so that a job started meanwhile
+        // does not have to wait for the thread to be woken up.
+        if (const int64_t spin = idleSpin.load(std::memory_order_relaxed))
+        {
+            lk.unlock();
+
+            const auto end = std::chrono::steady_clock::now() + std::chrono::microseconds(spin);
+
+            for (int i = 1; !jobStarted.load(std::memory_order_acquire); ++i)
+            {
+                spin_pause();
+
+                if (i % 64 == 0 && std::chrono::steady_clock::now() > end)
+                    break;
+            }
+
+            lk.lock();
+        }
+
+        cv.wait(lk, [&] { return jobStarted.load(std::memory_order_relaxed); });
+        jobStarted.store(false, std::memory_order_relaxed);
 
         if (exit)
             return;
@@ -140,6 +226,9 @@ Search::SearchManager* ThreadPool::main_manager() { return main_thread()->worker
 
 uint64_t ThreadPool::nodes_searched() const { return accumulate(&Search::Worker::nodes); }
 uint64_t ThreadPool::tb_hits() const { return accumulate(&Search::Worker::tbHits); }
+uint64_t ThreadPool::best_move_changes() const {
+    return accumulate(&Search::Worker::bestMoveChanges);
+}
 
 static size_t next_power_of_two(uint64_t count) { return count > 1 ? (2ULL << msb(count - 1)) : 1; }
 
@@ -208,6 +297,12 @@ void ThreadPool::set(const NumaConfig&                           numaConfig,
                 f();
         }
 
+        std::vector<NumaIndex> nodes;
+        for (auto pair : counts)
+            nodes.push_back(pair.first);
+
+        sharedState.tt.set_numa_nodes(nodes, doBindThreads ? boundThreadToNumaNode[0] : 0);
+
         auto threadsPerNode = counts;
         counts.clear();
 
@@ -280,6 +375,83 @@ void ThreadPool::wait_on_thread(size_t threadId) {
 
 size_t ThreadPool::num_threads() const { return threads.size(); }
 
+// Calls f on chunks of at most chunkSize indices covering [0, count), using all
+// the threads, and returns once all the chunks are done.
+void ThreadPool::parallel_for(size_t count, size_t chunkSize, const ParallelJob& f) {
+
+    std::vector<size_t> threadIds(threads.size());
+    std::iota(threadIds.begin(), threadIds.end(), 0);
+
+    parallel_for({{0, count, threadIds}}, chunkSize, f);
+}
+
+// Calls f on chunks of at most chunkSize indices covering each range, and returns
+// once all the chunks are done. Every thread of a range starts with an equal share
+// of it, and once its share is exhausted steals chunks from the shares of the
+// threads bound to the same NUMA node, never from other nodes, so that memory first
+// touched by a chunk is still local to the threads the range was meant for. Must not
+// be called from a thread of the pool.
+void ThreadPool::parallel_for(const std::vector<ParallelRange>& ranges,
+                              size_t                            chunkSize,
+                              const ParallelJob&                f) {
+
+    assert(chunkSize > 0);
+
+    struct alignas(64) Share {
+        std::atomic<size_t> next;
+        size_t              end;
+        size_t              threadId;
+    };
+
+    size_t shareCount = 0;
+    for (const auto& range : ranges)
+        shareCount += range.threadIds.size();
+
+    std::vector<Share>  shares(shareCount);
+    std::vector<size_t> firstShare(threads.size(), shareCount);
+    size_t              n = 0;
+
+    for (const auto& range : ranges)
+        for (size_t i = 0; i < range.threadIds.size(); ++i, ++n)
+        {
+            const size_t size  = range.end - range.begin;
+            const size_t count = range.threadIds.size();
+
+            shares[n].next     = range.begin + size * i / count;
+            shares[n].end      = range.begin + size * (i + 1) / count;
+            shares[n].threadId = range.threadIds[i];
+
+            firstShare[shares[n].threadId] = std::min(firstShare[shares[n].threadId], n);
+        }
+
+    auto numa_node = [&](size_t threadId) {
+        return boundThreadToNumaNode.empty() ? 0 : boundThreadToNumaNode[threadId];
+    };
+
+    for (size_t threadId = 0; threadId < threads.size(); ++threadId)
+        if (firstShare[threadId] < shareCount)
+            run_on_thread(threadId, [&, threadId]() {
+                // Start with the own shares, then visit the following ones in turn,
+                // so that the thieves spread over the remaining shares.
+                for (size_t k = 0; k < shareCount; ++k)
+                {
+                    Share& share = shares[(firstShare[threadId] + k) % shareCount];
+
+                    if (numa_node(share.threadId) != numa_node(threadId))
+                        continue;
+
+                    for (size_t begin;
+                         (begin = share.next.fetch_add(chunkSize, std::memory_order_relaxed))
+                         < share.end;)
+                        f(begin, std::min(begin + chunkSize, share.end), threadId);
+                }
+            });
+
+    for (size_t threadId = 0; threadId < threads.size(); ++threadId)
+        if (firstShare[threadId] < shareCount)
+            wait_on_thread(threadId);
+}
+
 
 // Wakes up main thread waiting in idle_loop() and returns immediately.
 // Main thread will wake up other threads and start the search.
@@ -290,26 +462,18 @@ void ThreadPool::start_thinking(const OptionsMap&  options,
 
     main_thread()->wait_for_search_finished();
 
+    thinkingStartTime = std::chrono::steady_clock::now();
+    startTogether     = options["ThreadStart"] == "together";
+
+    for (auto&& th : threads)
+        th->set_idle_spin(std::chrono::microseconds(int(options["ThreadSpin"])));
+
     main_manager()->stopOnPonderhit = stop = abortedSearch = false;
     main_manager()->ponder                                 = limits.ponderMode;
 
     increaseDepth = true;
 
-    Search::RootMoves rootMoves;
-    const auto        legalmoves = MoveList<LEGAL>(pos);
-
-    for (const auto& uciMove : limits.searchmoves)
-    {
-        auto move = UCIEngine::to_move(pos, uciMove);
-
-        if (std::find(legalmoves.begin(), legalmoves.end(), move) != legalmoves.end())
-            rootMoves.emplace_back(move);
-    }
-
-    if (rootMoves.empty())
-        for (const auto& m : legalmoves)
-            rootMoves.emplace_back(m);
-
+    Search::RootMoves  rootMoves = root_moves(pos, limits);
     Tablebases::Config tbConfig = Tablebases::rank_root_moves(options, pos, rootMoves);
 
     // After ownership transfer 'states' becomes empty, so if we stop the search
@@ -344,6 +508,101 @@ void ThreadPool::start_thinking(const OptionsMap&  options,
     main_thread()->start_searching();
 }
 
+// Analyses independent positions, each one searched by a single thread. The
+// threads steal the positions left to the others as soon as they are done with
+// their own, so that they are woken up only once for the whole batch. Blocks
+// until all the positions have been analysed.
+void ThreadPool::analyse_batch(
+  const std::vector<std::string>&                              fens,
+  bool                                                         isChess960,
+  const Search::LimitsType&                                    limits,
+  const std::function<void(size_t, const Search::InfoFull&)>& onResult) {
+
+    main_thread()->wait_for_search_finished();
+
+    stop = abortedSearch = false;
+    increaseDepth        = true;
+
+    parallel_for(fens.size(), 1, [&](size_t i, size_t, size_t threadId) {
+        threads[threadId]->worker->analyse(
+          fens[i], isChess960, limits, [&, i](const Search::InfoFull& info) { onResult(i, info); });
+    });
+}
+
+// Searches each root move on its own to the depth or node count of the limits,
+// instead of all the threads searching the same root. The moves are spread over
+// the threads, which steal the moves left to the others once done with their
+// own. Blocks until all the moves have been searched, then reports them sorted
+// by score as MultiPV lines and returns the total node count.
+uint64_t ThreadPool::analyse_root_moves(
+  const OptionsMap&                                    options,
+  Position&                                            pos,
+  StateListPtr&                                        states,
+  const Search::LimitsType&                            limits,
+  const std::function<void(const Search::InfoFull&)>& onUpdate) {
+
+    main_thread()->wait_for_search_finished();
+
+    stop = abortedSearch = false;
+    increaseDepth        = true;
+
+    Search::RootMoves  rootMoves = root_moves(pos, limits);
+    Tablebases::Config tbConfig  = Tablebases::rank_root_moves(options, pos, rootMoves);
+
+    assert(states.get() || setupStates.get());
+
+    if (states.get())
+        setupStates = std::move(states);  // Ownership transfer, states is now empty
+
+    // The reported infos refer to strings and moves owned by the worker, so they
+    // are copied before the worker goes on with the next move.
+    struct Line {
+        Search::InfoFull  info;
+        std::string       wdl, pv;
+        std::vector<Move> pvMoves;
+        int               tbRank;
+        Value             value;
+    };
+
+    std::vector<Line>     lines(rootMoves.size());
+    std::atomic<uint64_t> nodes = 0;
+
+    parallel_for(rootMoves.size(), 1, [&](size_t i, size_t, size_t threadId) {
+        Search::Worker& worker = *threads[threadId]->worker;
+        Line&           line   = lines[i];
+
+        worker.analyse(pos, setupStates->back(), rootMoves[i], tbConfig, limits,
+                       [&](const Search::InfoFull& info) {
+                           line.info = info;
+                           line.wdl  = info.wdl;
+                           line.pv   = info.pv;
+                           line.pvMoves.assign(info.pvMoves, info.pvMoves + info.pvLength);
+                       });
+
+        line.tbRank = worker.rootMoves[0].tbRank;
+        line.value  = worker.rootMoves[0].uciScore;
+        nodes += worker.nodes;
+    });
+
+    std::stable_sort(lines.begin(), lines.end(), [](const Line& a, const Line& b) {
+        return a.tbRank != b.tbRank ? a.tbRank > b.tbRank : a.value > b.value;
+    });
+
+    for (size_t i = 0; i < lines.size(); ++i)
+    {
+        Search::InfoFull& info = lines[i].info;
+
+        info.multiPV  = i + 1;
+        info.wdl      = lines[i].wdl;
+        info.pv       = lines[i].pv;
+        info.pvMoves  = lines[i].pvMoves.data();
+        info.pvLength = lines[i].pvMoves.size();
+        onUpdate(info);
+    }
+
+    return nodes;
+}
+
 Thread* ThreadPool::get_best_thread() const {
 
     Thread* bestThread = threads.front().get();
@@ -415,9 +674,46 @@ Thread* ThreadPool::get_best_thread() const {
 // Will be invoked by main thread after it has started searching.
 void ThreadPool::start_searching() {
 
+    // Hand the job to all the helpers first and release them afterwards, so
+    // that they start at about the same instant instead of one after the other.
+    for (auto&& th : threads)
+        if (th != threads.front())
+            th->start_searching(!startTogether);
+
+    if (startTogether)
+        for (auto&& th : threads)
+            if (th != threads.front())
+                th->start_job();
+}
+
+std::optional<std::chrono::microseconds> ThreadPool::helper_start_latency() const {
+
+    std::optional<std::chrono::microseconds> latency;
+
     for (auto&& th : threads)
         if (th != threads.front())
-            th->start_searching();
+        {
+            const auto start = th->searchStartTime.load(std::memory_order_relaxed);
+
+            if (start < thinkingStartTime)
+                return std::nullopt;  // Still waking up, or no search started yet
+
+            const auto us =
+              std::chrono::duration_cast<std::chrono::microseconds>(start - thinkingStartTime);
+            latency = std::max(latency.value_or(us), us);
+        }
+
+    return latency;
+}
+
+size_t ThreadPool::accumulator_bytes() const {
+
+    size_t bytes = 0;
+
+    for (auto&& th : threads)
+        bytes += th->worker->accumulatorStack.allocated_bytes();
+
+    return bytes;
 }
 
 
@@ -448,6 +744,17 @@ std::vector<size_t> ThreadPool::get_bound_thread_count_by_numa_node() const {
     return counts;
 }
 
+// Returns the ids of the threads bound to each NUMA node. When the threads
+// are not bound, they are all reported on node 0.
+std::map<NumaIndex, std::vector<size_t>> ThreadPool::get_thread_ids_by_numa_node() const {
+    std::map<NumaIndex, std::vector<size_t>> ids;
+
+    for (size_t i = 0; i < threads.size(); ++i)
+        ids[boundThreadToNumaNode.empty() ? 0 : boundThreadToNumaNode[i]].push_back(i);
+
+    return ids;
+}
+
 void ThreadPool::ensure_network_replicated() {
     for (auto&& th : threads)
         th->ensure_network_replicated();
@@ -20,12 +20,16 @@
 #define THREAD_H_INCLUDED
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <cstddef>
 #include <cstdint>
 #include <functional>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <string>
 #include <vector>
 
 #include "memory.h"
@@ -82,9 +86,13 @@ class Thread {
     virtual ~Thread();
 
     void idle_loop();
-    void start_searching();
+    void start_searching(bool start = true);
     void clear_worker();
-    void run_custom_job(std::function<void()> f);
+    void run_custom_job(std::function<void()> f, bool start = true);
+    void start_job();
+
+    // Time to busy wait for the next job before parking the thread
+    void set_idle_spin(std::chrono::microseconds spin) { idleSpin = spin.count(); }
 
     void ensure_network_replicated();
 
@@ -99,11 +107,16 @@ class Thread {
     LargePagePtr<Search::Worker> worker;
     std::function<void()>        jobFunc;
 
+    // When the thread last started to search
+    std::atomic<std::chrono::steady_clock::time_point> searchStartTime{};
+
    private:
     std::mutex                mutex;
     std::condition_variable   cv;
     size_t                    idx, idxInNuma, totalNuma, nthreads;
     bool                      exit = false, searching = true;  // Set before starting std::thread
+    std::atomic_bool          jobStarted{false};
+    std::atomic<int64_t>      idleSpin{0};
     NativeThread              stdThread;
     NumaReplicatedAccessToken numaAccessToken;
 };
@@ -132,24 +145,54 @@ class ThreadPool {
     ThreadPool& operator=(const ThreadPool&) = delete;
     ThreadPool& operator=(ThreadPool&&)      = delete;
 
-    void   start_thinking(const OptionsMap&, Position&, StateListPtr&, Search::LimitsType);
-    void   run_on_thread(size_t threadId, std::function<void()> f);
-    void   wait_on_thread(size_t threadId);
-    size_t num_threads() const;
-    void   clear();
-    void   set(const NumaConfig& numaConfig,
-               Search::SharedState,
-               const Search::SearchManager::UpdateContext&);
+    // A range of indices for parallel_for(), shared among the given threads
+    struct ParallelRange {
+        size_t              begin, end;
+        std::vector<size_t> threadIds;
+    };
+
+    // Called with a chunk [begin, end) of a range and the id of the thread running it
+    using ParallelJob = std::function<void(size_t begin, size_t end, size_t threadId)>;
+
+    void     start_thinking(const OptionsMap&, Position&, StateListPtr&, Search::LimitsType);
+    void     analyse_batch(const std::vector<std::string>&,
+                           bool,
+                           const Search::LimitsType&,
+                           const std::function<void(size_t, const Search::InfoFull&)>&);
+    uint64_t analyse_root_moves(const OptionsMap&,
+                                Position&,
+                                StateListPtr&,
+                                const Search::LimitsType&,
+                                const std::function<void(const Search::InfoFull&)>&);
+    void     run_on_thread(size_t threadId, std::function<void()> f);
+    void     wait_on_thread(size_t threadId);
+    void     parallel_for(size_t count, size_t chunkSize, const ParallelJob& f);
+    void     parallel_for(const std::vector<ParallelRange>& ranges,
+                          size_t                            chunkSize,
+                          const ParallelJob&                f);
+    size_t   num_threads() const;
+    void     clear();
+    void     set(const NumaConfig& numaConfig,
+                 Search::SharedState,
+                 const Search::SearchManager::UpdateContext&);
 
     Search::SearchManager* main_manager();
     Thread*                main_thread() const { return threads.front().get(); }
     uint64_t               nodes_searched() const;
     uint64_t               tb_hits() const;
+    uint64_t               best_move_changes() const;
     Thread*                get_best_thread() const;
     void                   start_searching();
     void                   wait_for_search_finished() const;
 
-    std::vector<size_t> get_bound_thread_count_by_numa_node() const;
+    // Time from the last start_thinking() until all the threads were searching
+    std::optional<std::chrono::microseconds> helper_start_latency() const;
+
+    // Bytes of NNUE accumulators allocated by the workers, see AccumulatorStack
+    size_t accumulator_bytes() const;
+
+    std::vector<size_t>                      get_bound_thread_count_by_numa_node() const;
+    std::map<NumaIndex, std::vector<size_t>> get_thread_ids_by_numa_node() const;
 
     void ensure_network_replicated();
 
@@ -163,9 +206,11 @@ class ThreadPool {
     auto empty() const noexcept { return threads.empty(); }
 
    private:
-    StateListPtr                         setupStates;
-    std::vector<std::unique_ptr<Thread>> threads;
-    std::vector<NumaIndex>               boundThreadToNumaNode;
+    StateListPtr                          setupStates;
+    std::vector<std::unique_ptr<Thread>>  threads;
+    std::vector<NumaIndex>                boundThreadToNumaNode;
+    std::chrono::steady_clock::time_point thinkingStartTime;
+    bool                                  startTogether = false;
 
     uint64_t accumulate(std::atomic<uint64_t> Search::Worker::* member) const {
 
@@ -24,6 +24,7 @@
 #include <cstring>
 #include <iostream>
 
+#include "counters.h"
 #include "memory.h"
 #include "misc.h"
 #include "syzygy/tbprobe.h"
@@ -45,6 +46,14 @@ namespace Stockfish {
 //
 // These fields are in the same order as accessed by TT::probe(), since memory is fastest sequentially.
 // Equally, the store order in save() matches this order.
+//
+// With TT_CLUSTER_64 the key takes 32 bits, making the entry 12 bytes. It is stored xor'ed with the
+// other fields, so that an entry torn by racing writes of two threads no longer matches either key.
+#ifdef TT_CLUSTER_64
+using TTKey = uint32_t;
+#else
+using TTKey = uint16_t;
+#endif
 
 struct TTEntry {
 
@@ -55,20 +64,21 @@ struct TTEntry {
                       Bound(genBound8 & 0x3), bool(genBound8 & 0x4)};
     }
 
-    bool is_occupied() const;
-    void save(Key k, Value v, bool pv, Bound b, Depth d, Move m, Value ev, uint8_t generation8);
+    bool  is_occupied() const;
+    TTKey key() const;
+    void  save(Key k, Value v, bool pv, Bound b, Depth d, Move m, Value ev, uint8_t generation8);
     // The returned age is a multiple of TranspositionTable::GENERATION_DELTA
     uint8_t relative_age(const uint8_t generation8) const;
 
    private:
     friend class TranspositionTable;
 
-    uint16_t key16;
-    uint8_t  depth8;
-    uint8_t  genBound8;
-    Move     move16;
-    int16_t  value16;
-    int16_t  eval16;
+    TTKey   partialKey;
+    uint8_t depth8;
+    uint8_t genBound8;
+    Move    move16;
+    int16_t value16;
+    int16_t eval16;
 };
 
 // `genBound8` is where most of the details are. We use the following constants to manipulate 5 leading generation bits
@@ -88,28 +98,48 @@ static constexpr int GENERATION_MASK = (0xFF << GENERATION_BITS) & 0xFF;
 // we sacrifice the ability to store depths greater than 1<<8 less the offset, as asserted in `save`.)
 bool TTEntry::is_occupied() const { return bool(depth8); }
 
+#ifdef TT_CLUSTER_64
+// The 8 bytes following the key, folded to the key size
+static TTKey fold_data(const TTEntry* tte) {
+    uint64_t data;
+    std::memcpy(&data, reinterpret_cast<const char*>(tte) + sizeof(TTKey), sizeof(data));
+    return TTKey(data ^ (data >> 32));
+}
+
+TTKey TTEntry::key() const { return partialKey ^ fold_data(this); }
+#else
+TTKey TTEntry::key() const { return partialKey; }
+#endif
+
 // Populates the TTEntry with a new node's data, possibly
 // overwriting an old position. The update is not atomic and can be racy.
 void TTEntry::save(
   Key k, Value v, bool pv, Bound b, Depth d, Move m, Value ev, uint8_t generation8) {
 
+    const bool newKey = TTKey(k) != key();
+
     // Preserve the old ttmove if we don't have a new one
-    if (m || uint16_t(k) != key16)
+    if (m || newKey)
         move16 = m;
 
     // Overwrite less valuable entries (cheapest checks first)
-    if (b == BOUND_EXACT || uint16_t(k) != key16 || d - DEPTH_ENTRY_OFFSET + 2 * pv > depth8 - 4
+    if (b == BOUND_EXACT || newKey || d - DEPTH_ENTRY_OFFSET + 2 * pv > depth8 - 4
         || relative_age(generation8))
     {
         assert(d > DEPTH_ENTRY_OFFSET);
         assert(d < 256 + DEPTH_ENTRY_OFFSET);
 
-        key16     = uint16_t(k);
-        depth8    = uint8_t(d - DEPTH_ENTRY_OFFSET);
-        genBound8 = uint8_t(generation8 | uint8_t(pv) << 2 | b);
-        value16   = int16_t(v);
-        eval16    = int16_t(ev);
+        partialKey = TTKey(k);
+        depth8     = uint8_t(d - DEPTH_ENTRY_OFFSET);
+        genBound8  = uint8_t(generation8 | uint8_t(pv) << 2 | b);
+        value16    = int16_t(v);
+        eval16     = int16_t(ev);
     }
+
+#ifdef TT_CLUSTER_64
+    // Store the key last, xor'ed with whatever data the entry now holds
+    partialKey = TTKey(k) ^ fold_data(this);
+#endif
 }
 
 
@@ -137,6 +167,16 @@ void TTWriter::write(
 // of TTEntry. Each non-empty TTEntry contains information on exactly one position. The size of a Cluster should
 // divide the size of a cache line for best performance, as the cacheline is prefetched when possible.
 
+#ifdef TT_CLUSTER_64
+static constexpr int ClusterSize = 5;
+
+struct Cluster {
+    TTEntry entry[ClusterSize];
+    char    padding[4];  // Pad to 64 bytes, the cache line size on most hosts
+};
+
+static_assert(sizeof(Cluster) == 64, "Suboptimal Cluster size");
+#else
 static constexpr int ClusterSize = 3;
 
 struct Cluster {
@@ -145,55 +185,137 @@ struct Cluster {
 };
 
 static_assert(sizeof(Cluster) == 32, "Suboptimal Cluster size");
+#endif
 
 
 // Sets the size of the transposition table,
 // measured in megabytes. Transposition table consists
 // of clusters and each cluster consists of ClusterSize number of TTEntry.
+// A replicated table divides the size among the nodes.
 void TranspositionTable::resize(size_t mbSize, ThreadPool& threads) {
+    const size_t newClusterCount =
+      mbSize * 1024 * 1024 / sizeof(Cluster) / (replicas.size() + 1);
+
+    allocate(newClusterCount);
+    for (auto& [n, replica] : replicas)
+        replica->allocate(newClusterCount);
+
+    clear(threads);
+}
+
+
+void TranspositionTable::allocate(size_t newClusterCount) {
     aligned_large_pages_free(table);
 
-    clusterCount = mbSize * 1024 * 1024 / sizeof(Cluster);
+    clusterCount = newClusterCount;
 
     table = static_cast<Cluster*>(aligned_large_pages_alloc(clusterCount * sizeof(Cluster)));
 
     if (!table)
     {
-        std::cerr << "Failed to allocate " << mbSize << "MB for transposition table." << std::endl;
+        std::cerr << "Failed to allocate " << clusterCount * sizeof(Cluster) / (1024 * 1024)
+                  << "MB for transposition table." << std::endl;
         exit(EXIT_FAILURE);
     }
-
-    clear(threads);
 }
 
 
+// Clusters handled at once by a thread when the whole table is zeroed, saved
+// or loaded.
+static constexpr size_t ClusterChunk = 2 * 1024 * 1024 / sizeof(Cluster);
+
+
 // Initializes the entire transposition table to zero,
-// in a multi-threaded way.
+// in a multi-threaded way. Memory pages are mapped on the
+// NUMA node of the thread that first touches them, so with
+// a NUMA mode each part is zeroed by the threads of its node.
 void TranspositionTable::clear(ThreadPool& threads) {
-    generation8              = 0;
-    const size_t threadCount = threads.num_threads();
+    const auto nodeThreads = threads.get_thread_ids_by_numa_node();
+
+    // The tables to zero with the index of their first cluster, as if they
+    // followed each other in memory.
+    std::vector<std::pair<size_t, Cluster*>> tables{{0, table}};
+    std::vector<ThreadPool::ParallelRange>   ranges;
+
+    generation8 = 0;
+
+    if (numaMode == NumaMode::Shared)
+    {
+        std::vector<size_t> threadIds;
+        for (const auto& [n, ids] : nodeThreads)
+            threadIds.insert(threadIds.end(), ids.begin(), ids.end());
 
-    for (size_t i = 0; i < threadCount; ++i)
+        ranges.push_back({0, clusterCount, threadIds});
+    }
+    else if (numaMode == NumaMode::Partitioned)
     {
-        threads.run_on_thread(i, [this, i, threadCount]() {
-            // Each thread will zero its part of the hash table
-            const size_t stride = clusterCount / threadCount;
-            const size_t start  = stride * i;
-            const size_t len    = i + 1 != threadCount ? stride : clusterCount - start;
-
-            std::memset(&table[start], 0, len * sizeof(Cluster));
-        });
+        // Slices follow the order of the nodes, as mul_hi64() in first_entry()
+        // maps the keys to the clusters in order.
+        size_t slice = 0;
+        for (const auto& [n, threadIds] : nodeThreads)
+        {
+            const size_t begin = clusterCount * slice / nodeThreads.size();
+            const size_t end   = clusterCount * ++slice / nodeThreads.size();
+
+            ranges.push_back({begin, end, threadIds});
+        }
     }
+    else
+    {
+        ranges.push_back({0, clusterCount, nodeThreads.at(numaNode)});
+
+        for (auto& [n, replica] : replicas)
+        {
+            const size_t begin = ranges.back().end;
+
+            replica->generation8 = 0;
+            tables.emplace_back(begin, replica->table);
+            ranges.push_back({begin, begin + replica->clusterCount, nodeThreads.at(n)});
+        }
+    }
+
+    // A chunk never spans two tables, as it never spans two ranges
+    threads.parallel_for(ranges, ClusterChunk, [&](size_t begin, size_t end, size_t) {
+        size_t i = tables.size() - 1;
+        while (tables[i].first > begin)
+            --i;
+
+        std::memset(&tables[i].second[begin - tables[i].first], 0, (end - begin) * sizeof(Cluster));
+    });
+}
+
+
+void TranspositionTable::set_numa_nodes(const std::vector<NumaIndex>& nodes, NumaIndex mainNode) {
+    numaNode = mainNode;
+
+    replicas.clear();
+
+    if (numaMode == NumaMode::Replicated)
+        for (NumaIndex n : nodes)
+            if (n != mainNode)
+                replicas.emplace(n, std::make_unique<TranspositionTable>());
+}
 
-    for (size_t i = 0; i < threadCount; ++i)
-        threads.wait_on_thread(i);
+
+TranspositionTable& TranspositionTable::numa_table(NumaIndex n) {
+    return n == numaNode || replicas.empty() ? *this : *replicas.at(n);
 }
 
 
 // Returns an approximation of the hashtable
 // occupation during a search. The hash is x permill full, as per UCI protocol.
 // Only counts entries which match the current generation.
+// A replicated table reports the average over all the nodes.
 int TranspositionTable::hashfull(int maxAge) const {
+    int total = table_hashfull(maxAge);
+    for (auto& [n, replica] : replicas)
+        total += replica->table_hashfull(maxAge);
+
+    return total / int(replicas.size() + 1);
+}
+
+
+int TranspositionTable::table_hashfull(int maxAge) const {
     int maxAgeInternal = maxAge << GENERATION_BITS;
     int cnt            = 0;
     for (int i = 0; i < 1000; ++i)
@@ -208,6 +330,9 @@ int TranspositionTable::hashfull(int maxAge) const {
 void TranspositionTable::new_search() {
     // increment by delta to keep lower bits as is
     generation8 += GENERATION_DELTA;
+
+    for (auto& [n, replica] : replicas)
+        replica->new_search();
 }
 
 
@@ -222,14 +347,23 @@ uint8_t TranspositionTable::generation() const { return generation8; }
 // TTEntry t2 if its replace value is greater than that of t2.
 std::tuple<bool, TTData, TTWriter> TranspositionTable::probe(const Key key) const {
 
-    TTEntry* const tte   = first_entry(key);
-    const uint16_t key16 = uint16_t(key);  // Use the low 16 bits as key inside the cluster
+    TTEntry* const tte        = first_entry(key);
+    const TTKey    partialKey = TTKey(key);  // Use the low bits as key inside the cluster
 
     for (int i = 0; i < ClusterSize; ++i)
-        if (tte[i].key16 == key16)
-            // This gap is the main place for read races.
-            // After `read()` completes that copy is final, but may be self-inconsistent.
-            return {tte[i].is_occupied(), tte[i].read(), TTWriter(&tte[i])};
+    {
+        // This copy is the main place for read races. Once completed it is final, but may be
+        // self-inconsistent. With TT_CLUSTER_64 most inconsistent copies fail the key check.
+        const TTEntry tteCopy = tte[i];
+
+        if (tteCopy.key() == partialKey)
+        {
+            Counters::inc(tteCopy.is_occupied() ? Counters::TTHit : Counters::TTMiss);
+            return {tteCopy.is_occupied(), tteCopy.read(), TTWriter(&tte[i])};
+        }
+    }
+
+    Counters::inc(Counters::TTMiss);
 
     // Find an entry to be replaced according to the replacement strategy
     TTEntry* replace = tte;
@@ -248,4 +382,97 @@ TTEntry* TranspositionTable::first_entry(const Key key) const {
     return &table[mul_hi64(key, clusterCount)].entry[0];
 }
 
+
+// A hash file is a page sized header followed by a raw copy of the cluster
+// array. The file is memory mapped so that each thread can copy its own part
+// of the table, in the same way as clear() does.
+struct HashFileHeader {
+    char     magic[8];
+    char     version[64];
+    uint64_t clusterCount;
+    uint64_t clusterSize;
+    uint8_t  generation8;
+};
+
+static constexpr char   HashFileMagic[8]   = {'S', 'F', 'H', 'A', 'S', 'H', '0', '1'};
+static constexpr size_t HashFileHeaderSize = 4096;
+
+static_assert(sizeof(HashFileHeader) <= HashFileHeaderSize, "Hash file header too big");
+
+// Writes the whole table, including the current generation, to the given file.
+// The engine version is recorded so that a dump is never loaded by a binary
+// that may interpret the entries differently.
+std::optional<std::string> TranspositionTable::save(const std::string& filename,
+                                                    ThreadPool&        threads) const {
+
+    if (!replicas.empty())
+        return std::string("A replicated hash table cannot be saved");
+
+    MappedFile file(filename, HashFileHeaderSize + clusterCount * sizeof(Cluster));
+
+    if (!file.data())
+        return "Could not create file " + filename;
+
+    HashFileHeader header{};
+    std::memcpy(header.magic, HashFileMagic, sizeof(HashFileMagic));
+    std::strncpy(header.version, engine_version_info().c_str(), sizeof(header.version) - 1);
+    header.clusterCount = clusterCount;
+    header.clusterSize  = sizeof(Cluster);
+    header.generation8  = generation8;
+    std::memcpy(file.data(), &header, sizeof(header));
+
+    Cluster* dst = reinterpret_cast<Cluster*>(file.data() + HashFileHeaderSize);
+
+    threads.parallel_for(clusterCount, ClusterChunk, [this, dst](size_t begin, size_t end, size_t) {
+        std::memcpy(&dst[begin], &table[begin], (end - begin) * sizeof(Cluster));
+    });
+
+    return std::nullopt;
+}
+
+
+// Restores a table written by save(). The file must come from the same engine
+// version and match the current hash size, otherwise the table is left untouched.
+std::optional<std::string> TranspositionTable::load(const std::string& filename,
+                                                    ThreadPool&        threads) {
+
+    if (!replicas.empty())
+        return std::string("A replicated hash table cannot be loaded");
+
+    MappedFile file(filename);
+
+    if (!file.data())
+        return "Could not open file " + filename;
+
+    HashFileHeader header{};
+    char           version[sizeof(header.version)]{};
+    std::strncpy(version, engine_version_info().c_str(), sizeof(version) - 1);
+
+    if (file.size() >= HashFileHeaderSize)
+        std::memcpy(&header, file.data(), sizeof(header));
+
+    if (std::memcmp(header.magic, HashFileMagic, sizeof(HashFileMagic))
+        || header.clusterSize != sizeof(Cluster))
+        return filename + " is not a valid hash file";
+
+    if (std::memcmp(header.version, version, sizeof(version)))
+        return filename + " was written by a different engine version ("
+             + std::string(header.version, strnlen(header.version, sizeof(header.version))) + ")";
+
+    if (header.clusterCount != clusterCount
+        || file.size() != HashFileHeaderSize + clusterCount * sizeof(Cluster))
+        return filename + " requires a Hash size of "
+             + std::to_string(header.clusterCount * sizeof(Cluster) / (1024 * 1024)) + " MB";
+
+    const Cluster* src = reinterpret_cast<const Cluster*>(file.data() + HashFileHeaderSize);
+
+    threads.parallel_for(clusterCount, ClusterChunk, [this, src](size_t begin, size_t end, size_t) {
+        std::memcpy(&table[begin], &src[begin], (end - begin) * sizeof(Cluster));
+    });
+
+    generation8 = header.generation8;
+
+    return std::nullopt;
+}
+
 }  // namespace Stockfish
@@ -21,9 +21,15 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
 #include <tuple>
+#include <vector>
 
 #include "memory.h"
+#include "numa.h"
 #include "types.h"
 
 namespace Stockfish {
@@ -81,6 +87,19 @@ struct TTWriter {
 class TranspositionTable {
 
    public:
+    // How the table is spread over the NUMA nodes the threads are bound to.
+    // Shared: a single table, each thread zeroes a part of it.
+    // Partitioned: a single table, split in one contiguous slice of clusters per
+    // node. The slice is first touched by the threads of its node, so a key is
+    // always stored in the memory of the same node.
+    // Replicated: one table per node, used only by the threads of that node.
+    // The Hash size is divided among the tables.
+    enum class NumaMode {
+        Shared,
+        Partitioned,
+        Replicated
+    };
+
     ~TranspositionTable() { aligned_large_pages_free(table); }
 
     void resize(size_t mbSize, ThreadPool& threads);  // Set TT size
@@ -96,13 +115,40 @@ class TranspositionTable {
     TTEntry* first_entry(const Key key)
       const;  // This is the hash function; its only external use is memory prefetching.
 
+    // Dump the table to a file, or restore it from one, in a multi-threaded way.
+    // Both return an error message on failure.
+    std::optional<std::string> save(const std::string& filename, ThreadPool& threads) const;
+    std::optional<std::string> load(const std::string& filename, ThreadPool& threads);
+
+    // Takes effect when the threads are recreated, see set_numa_nodes()
+    void     set_numa_mode(NumaMode mode) { numaMode = mode; }
+    NumaMode numa_mode() const { return numaMode; }
+
+    // Called by the thread pool before the threads are created, with the nodes
+    // they are bound to. The table of mainNode is this one, so that the main
+    // thread ages and reports all the tables. The tables are allocated by the
+    // next resize().
+    void set_numa_nodes(const std::vector<NumaIndex>& nodes, NumaIndex mainNode);
+
+    // The table to be used by the threads bound to the given node
+    TranspositionTable& numa_table(NumaIndex n);
+
    private:
     friend struct TTEntry;
 
+    void allocate(size_t newClusterCount);
+    int  table_hashfull(int maxAge) const;
+
     size_t   clusterCount;
     Cluster* table = nullptr;
 
     uint8_t generation8 = 0;  // Size must be not bigger than TTEntry::genBound8
+
+    NumaMode  numaMode = NumaMode::Shared;
+    NumaIndex numaNode = 0;
+
+    // Tables of the other nodes, only in Replicated mode
+    std::map<NumaIndex, std::unique_ptr<TranspositionTable>> replicas;
 };
 
 }  // namespace Stockfish
@@ -19,9 +19,11 @@
 #include "uci.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cctype>
 #include <cmath>
 #include <cstdint>
+#include <fstream>
 #include <iterator>
 #include <optional>
 #include <sstream>
@@ -32,7 +34,9 @@
 #include "benchmark.h"
 #include "engine.h"
 #include "memory.h"
+#include "microbench.h"
 #include "movegen.h"
+#include "movepick.h"
 #include "position.h"
 #include "score.h"
 #include "search.h"
@@ -44,6 +48,7 @@ namespace Stockfish {
 constexpr auto BenchmarkCommand = "speedtest";
 
 constexpr auto StartFEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
 template<typename... Ts>
 struct overload: Ts... {
     using Ts::operator()...;
@@ -73,15 +78,43 @@ UCIEngine::UCIEngine(int argc, char** argv) :
             print_info_string(*str);
     });
 
+    // Search output for machine consumers, see the formats below on_bestmove()
+    engine.get_options().add(  //
+      "OutputFormat", Option("text var text var json var binary", "text", [this](const Option&) {
+          init_search_update_listeners();
+          return std::nullopt;
+      }));
+
     init_search_update_listeners();
 }
 
 void UCIEngine::init_search_update_listeners() {
-    engine.set_on_iter([](const auto& i) { on_iter(i); });
-    engine.set_on_update_no_moves([](const auto& i) { on_update_no_moves(i); });
-    engine.set_on_update_full(
-      [this](const auto& i) { on_update_full(i, engine.get_options()["UCI_ShowWDL"]); });
-    engine.set_on_bestmove([](const auto& bm, const auto& p) { on_bestmove(bm, p); });
+    const std::string format = engine.get_options()["OutputFormat"];
+
+    if (format == "json")
+    {
+        engine.set_on_iter([](const auto& i) { on_iter_json(i); });
+        engine.set_on_update_no_moves([](const auto& i) { on_update_no_moves_json(i); });
+        engine.set_on_update_full(
+          [this](const auto& i) { on_update_full_json(i, engine.get_options()["UCI_ShowWDL"]); });
+        engine.set_on_bestmove([](const auto& bm, const auto& p) { on_bestmove_json(bm, p); });
+    }
+    else if (format == "binary")
+    {
+        engine.set_on_iter([](const auto& i) { on_iter_binary(i); });
+        engine.set_on_update_no_moves([](const auto& i) { on_update_no_moves_binary(i); });
+        engine.set_on_update_full([](const auto& i) { on_update_full_binary(i); });
+        engine.set_on_bestmove([](const auto& bm, const auto& p) { on_bestmove_binary(bm, p); });
+    }
+    else
+    {
+        engine.set_on_iter([](const auto& i) { on_iter(i); });
+        engine.set_on_update_no_moves([](const auto& i) { on_update_no_moves(i); });
+        engine.set_on_update_full(
+          [this](const auto& i) { on_update_full(i, engine.get_options()["UCI_ShowWDL"]); });
+        engine.set_on_bestmove([](const auto& bm, const auto& p) { on_bestmove(bm, p); });
+    }
+
     engine.set_on_verify_networks([](const auto& s) { print_info_string(s); });
 }
 
@@ -144,10 +177,22 @@ void UCIEngine::loop() {
             bench(is);
         else if (token == BenchmarkCommand)
             benchmark(is);
+        else if (token == "analyse_batch")
+            analyse_batch(is);
+        else if (token == "analyse_moves")
+            analyse_moves(is);
+        else if (token == "infobench")
+            info_bench(is);
+        else if (token == "movepickbench")
+            movepick_bench(is);
+        else if (token == "microbench")
+            microbench(is);
         else if (token == "d")
             sync_cout << engine.visualize() << sync_endl;
         else if (token == "eval")
             engine.trace_eval();
+        else if (token == "stats")
+            sync_cout << engine.search_counters() << sync_endl;
         else if (token == "compiler")
             sync_cout << compiler_info() << sync_endl;
         else if (token == "export_net")
@@ -162,6 +207,19 @@ void UCIEngine::loop() {
 
             engine.save_network(files);
         }
+        else if (token == "export_raw_net")
+        {
+            std::optional<std::string> files[2];
+            std::string                file;
+
+            for (auto& f : files)
+                if (is >> std::skipws >> file)
+                    f = file;
+
+            engine.save_raw_network(files);
+        }
+        else if (token == "save_hash" || token == "load_hash")
+            hash_file(token, is);
         else if (token == "--help" || token == "help" || token == "--license" || token == "license")
             sync_cout
               << "\nStockfish is a powerful chess engine for playing and analyzing."
@@ -293,16 +351,33 @@ void UCIEngine::bench(std::istream& args) {
               << "\nNodes/second    : " << 1000 * nodes / elapsed << std::endl;
 
     // reset callback, to not capture a dangling reference to nodesSearched
-    engine.set_on_update_full([&](const auto& i) { on_update_full(i, options["UCI_ShowWDL"]); });
+    init_search_update_listeners();
 }
 
+// The positional arguments of the speedtest may be followed by "runs <n>", to run
+// the whole suite n times after a single warmup, and by "json", to also print the
+// nodes per second of every run, their median and a 95% confidence interval of the
+// median as JSON on stdout. The tests/speedtest.sh script compares them with a
+// stored baseline.
 void UCIEngine::benchmark(std::istream& args) {
     // Probably not very important for a test this long, but include for completeness and sanity.
     static constexpr int NUM_WARMUP_POSITIONS = 3;
 
-    std::string token;
+    std::string token, positional;
     uint64_t    nodes = 0, cnt = 1;
     uint64_t    nodesSearched = 0;
+    int         runs          = 1;
+    bool        json          = false;
+
+    while (args >> token)
+        if (token == "runs")
+            args >> runs;
+        else if (token == "json")
+            json = true;
+        else
+            positional += token + " ";
+
+    runs = std::max(runs, 1);
 
     engine.set_on_update_full([&](const Engine::InfoFull& i) { nodesSearched = i.nodes; });
 
@@ -311,7 +386,8 @@ void UCIEngine::benchmark(std::istream& args) {
     engine.set_on_bestmove([](const auto&, const auto&) {});
     engine.set_on_verify_networks([](const auto&) {});
 
-    Benchmark::BenchmarkSetup setup = Benchmark::setup_benchmark(args);
+    std::istringstream        positionalArgs(positional);
+    Benchmark::BenchmarkSetup setup = Benchmark::setup_benchmark(positionalArgs);
 
     const auto numGoCommands = count_if(setup.commands.begin(), setup.commands.end(),
                                         [](const std::string& s) { return s.find("go ") == 0; });
@@ -323,6 +399,8 @@ void UCIEngine::benchmark(std::istream& args) {
     setoption(ss);
     ss = std::istringstream("name Hash value " + std::to_string(setup.ttSize));
     setoption(ss);
+    ss = std::istringstream("name HashNumaMode value " + setup.hashNumaMode);
+    setoption(ss);
     ss = std::istringstream("name UCI_Chess960 value false");
     setoption(ss);
 
@@ -376,46 +454,74 @@ void UCIEngine::benchmark(std::istream& args) {
         }
     };
 
-    engine.search_clear();  // search_clear may take a while
+    std::vector<uint64_t> nps;
 
-    for (const auto& cmd : setup.commands)
+    for (int run = 1; run <= runs; ++run)
     {
-        std::istringstream is(cmd);
-        is >> std::skipws >> token;
+        uint64_t  runNodes = 0;
+        TimePoint runTime  = 0;
 
-        if (token == "go")
+        if (runs > 1)
+            std::cerr << "Run " << run << '/' << runs << '\n';
+
+        cnt = 1;
+        engine.search_clear();  // search_clear may take a while
+
+        for (const auto& cmd : setup.commands)
         {
-            // One new line is produced by the search, so omit it here
-            std::cerr << "\rPosition " << cnt++ << '/' << numGoCommands;
+            std::istringstream is(cmd);
+            is >> std::skipws >> token;
 
-            Search::LimitsType limits = parse_limits(is);
+            if (token == "go")
+            {
+                // One new line is produced by the search, so omit it here
+                std::cerr << "\rPosition " << cnt++ << '/' << numGoCommands;
 
-            nodesSearched     = 0;
-            TimePoint elapsed = now();
+                Search::LimitsType limits = parse_limits(is);
 
-            // Run with silenced network verification
-            engine.go(limits);
-            engine.wait_for_search_finished();
+                nodesSearched     = 0;
+                TimePoint elapsed = now();
 
-            totalTime += now() - elapsed;
+                // Run with silenced network verification
+                engine.go(limits);
+                engine.wait_for_search_finished();
 
-            updateHashfullReadings();
+                runTime += now() - elapsed;
 
-            nodes += nodesSearched;
-        }
-        else if (token == "position")
-            position(is);
-        else if (token == "ucinewgame")
-        {
-            engine.search_clear();  // search_clear may take a while
+                updateHashfullReadings();
+
+                runNodes += nodesSearched;
+            }
+            else if (token == "position")
+                position(is);
+            else if (token == "ucinewgame")
+            {
+                engine.search_clear();  // search_clear may take a while
+            }
         }
+
+        std::cerr << "\n";
+
+        nodes += runNodes;
+        totalTime += runTime;
+        nps.push_back(1000 * runNodes / std::max<TimePoint>(runTime, 1));
     }
 
     totalTime = std::max<TimePoint>(totalTime, 1);  // Ensure positivity to avoid a 'divide by zero'
 
     dbg_print();
 
-    std::cerr << "\n";
+    // The confidence interval of the median is given by the order statistics around
+    // it, using the normal approximation of the binomial distribution. With fewer
+    // than 6 runs, it spans all of them.
+    std::vector<uint64_t> sorted(nps);
+    std::sort(sorted.begin(), sorted.end());
+
+    const uint64_t median = runs % 2 ? sorted[runs / 2]
+                                     : (sorted[runs / 2 - 1] + sorted[runs / 2]) / 2;
+    const double   spread = 0.98 * std::sqrt(double(runs));
+    const uint64_t ciLow  = sorted[std::max(int(std::floor(runs / 2.0 - spread)) - 1, 0)];
+    const uint64_t ciHigh = sorted[std::min(int(std::ceil(runs / 2.0 + spread)), runs - 1)];
 
     static_assert(
       std::size(hashfullAges) == 2 && hashfullAges[0] == 0 && hashfullAges[1] == 999,
@@ -425,6 +531,8 @@ void UCIEngine::benchmark(std::istream& args) {
     if (threadBinding.empty())
         threadBinding = "none";
 
+    const std::string ttNumaMode(engine.get_options()["HashNumaMode"]);
+
     // clang-format off
 
     std::cerr << "==========================="
@@ -440,6 +548,7 @@ void UCIEngine::benchmark(std::istream& args) {
               << "\nThread count               : " << setup.threads
               << "\nThread binding             : " << threadBinding
               << "\nTT size [MiB]              : " << setup.ttSize
+              << "\nTT NUMA mode               : " << ttNumaMode
               << "\nHash max, avg [per mille]  : "
               << "\n    single search          : " << maxHashfull[0] << ", "
               << totalHashfull[0] / numHashfullReadings
@@ -449,16 +558,315 @@ void UCIEngine::benchmark(std::istream& args) {
               << "\nTotal search time [s]      : " << totalTime / 1000.0
               << "\nNodes/second               : " << 1000 * nodes / totalTime << std::endl;
 
+    if (runs > 1)
+        std::cerr << "Runs                       : " << runs
+                  << "\nNodes/second median        : " << median
+                  << "\nNodes/second 95% CI        : " << ciLow << ", " << ciHigh << std::endl;
+
     // clang-format on
 
+    if (json)
+    {
+        std::stringstream out;
+
+        out << "{\n  \"engine\": \"" << engine_info() << "\","
+            << "\n  \"invocation\": \"" << BenchmarkCommand << " " << setup.filledInvocation
+            << "\",\n  \"runs\": " << runs << ",\n  \"nps\": [";
+
+        for (size_t i = 0; i < nps.size(); ++i)
+            out << (i ? ", " : "") << nps[i];
+
+        out << "],\n  \"nps_median\": " << median << ",\n  \"nps_ci_low\": " << ciLow
+            << ",\n  \"nps_ci_high\": " << ciHigh << "\n}";
+
+        sync_cout << out.str() << sync_endl;
+    }
+
     init_search_update_listeners();
 }
 
+// Analyses all the positions of a file, one FEN per line, to the given depth or
+// node count. Each position is searched by a single thread, and the result is
+// printed as one JSON line as soon as it is available, so the output order does
+// not follow the input order. The "id" field is the index of the position.
+void UCIEngine::analyse_batch(std::istream& args) {
+    std::string file, line;
+
+    if (!(args >> std::skipws >> file))
+    {
+        print_info_string("ERROR: analyse_batch requires a file name");
+        return;
+    }
+
+    Search::LimitsType limits = parse_limits(args);
+
+    if (!limits.depth && !limits.nodes)
+    {
+        print_info_string("ERROR: analyse_batch requires a depth or nodes limit");
+        return;
+    }
+
+    std::ifstream            f(file);
+    std::vector<std::string> fens;
+
+    if (!f.is_open())
+    {
+        print_info_string("ERROR: Unable to open file " + file);
+        return;
+    }
+
+    while (std::getline(f, line))
+        if (!is_whitespace(line) && line[0] != '#')
+            fens.push_back(line);
+
+    std::atomic<uint64_t> nodes = 0;
+    TimePoint             elapsed = now();
+
+    engine.analyse_batch(fens, limits, [&](size_t id, const Engine::InfoFull& info) {
+        nodes += info.nodes;
+
+        // format_score() returns the score type and its value, e.g. "cp 23"
+        const std::string score = format_score(info.score);
+        const size_t      sep   = score.find(' ');
+        std::stringstream ss;
+
+        ss << "{\"id\": " << id                                      //
+           << ", \"fen\": \"" << fens[id] << "\""                      //
+           << ", \"depth\": " << info.depth                          //
+           << ", \"seldepth\": " << info.selDepth                    //
+           << ", \"score\": {\"" << score.substr(0, sep) << "\": "  //
+           << score.substr(sep + 1) << "}";
+
+        if (!info.bound.empty())
+            ss << ", \"bound\": \"" << info.bound << "\"";
+
+        if (!info.wdl.empty())
+        {
+            std::string wdl(info.wdl);
+            std::replace(wdl.begin(), wdl.end(), ' ', ',');
+            ss << ", \"wdl\": [" << wdl << "]";
+        }
+
+        ss << ", \"nodes\": " << info.nodes    //
+           << ", \"nps\": " << info.nps        //
+           << ", \"tbhits\": " << info.tbHits  //
+           << ", \"time\": " << info.timeMs    //
+           << ", \"pv\": [";
+
+        for (auto m : split(info.pv, " "))
+            ss << (m.data() != info.pv.data() ? ", \"" : "\"") << m << "\"";
+
+        ss << "]}";
+
+        sync_cout << ss.str() << sync_endl;
+    });
+
+    elapsed = now() - elapsed + 1;  // Ensure positivity to avoid a 'divide by zero'
+
+    std::cerr << "\n==========================="            //
+              << "\nPositions       : " << fens.size()     //
+              << "\nTotal time (ms) : " << elapsed         //
+              << "\nNodes searched  : " << nodes           //
+              << "\nNodes/second    : " << 1000 * nodes / elapsed << std::endl;
+}
+
+// Searches every legal move of the current position, or those given with
+// searchmoves, to the given depth or node count. Instead of all the threads
+// searching the same root, each move is searched by a single thread. Once all
+// of them are done they are printed as MultiPV lines, best move first.
+void UCIEngine::analyse_moves(std::istream& args) {
+    Search::LimitsType limits = parse_limits(args);
+
+    if (!limits.depth && !limits.nodes)
+    {
+        print_info_string("ERROR: analyse_moves requires a depth or nodes limit");
+        return;
+    }
+
+    TimePoint elapsed = now();
+    uint64_t  nodes   = engine.analyse_root_moves(limits);
+
+    elapsed = now() - elapsed + 1;  // Ensure positivity to avoid a 'divide by zero'
+
+    std::cerr << "\n==========================="           //
+              << "\nTotal time (ms) : " << elapsed        //
+              << "\nNodes searched  : " << nodes          //
+              << "\nNodes/second    : " << 1000 * nodes / elapsed << std::endl;
+}
+
+// Times the formatting of the info lines sent at a high MultiPV, the way
+// SearchManager::pv() and on_update_full() build them but without the output.
+// The root moves of a position with many legal moves get fixed PVs of 20 plies.
+void UCIEngine::info_bench(std::istream& args) {
+    constexpr auto Fen   = "R6R/3Q4/1Q4Q1/4Q3/2Q4Q/Q4Q2/pp1Q4/kBNN1KB1 w - - 0 1";
+    constexpr int  Plies = 20;
+
+    size_t multiPV = 50, iterations = 20000;
+    args >> multiPV >> iterations;
+
+    StateInfo                      st, states[Plies + 1];
+    Position                       pos;
+    std::vector<std::vector<Move>> pvs;
+
+    pos.set(Fen, false, &st);
+
+    const auto rootMoves = MoveList<LEGAL>(pos);
+    multiPV              = std::min(multiPV, rootMoves.size());
+
+    for (size_t i = 0; i < multiPV; ++i)
+    {
+        Position p;
+        p.set(Fen, false, &states[0]);
+        pvs.emplace_back(1, rootMoves.begin()[i]);
+        p.do_move(pvs.back()[0], states[1]);
+
+        for (int ply = 1; ply < Plies; ++ply)
+        {
+            const auto moves = MoveList<LEGAL>(p);
+
+            if (!moves.size())
+                break;
+
+            pvs.back().push_back(moves.begin()[(i + ply) % moves.size()]);
+            p.do_move(pvs.back().back(), states[ply + 1]);
+        }
+    }
+
+    uint64_t  bytes   = 0;
+    TimePoint elapsed = now();
+
+    for (size_t n = 0; n < iterations; ++n)
+        for (size_t i = 0; i < multiPV; ++i)
+        {
+            const Value v = Value(int(i * 7 + n % 50) - 150);
+
+            InfoString pv, wdl, line;
+
+            for (Move m : pvs[i])
+            {
+                append_move(pv, m, false);
+                pv << ' ';
+            }
+            pv.pop_back();
+
+            append_wdl(wdl, v, pos);
+
+            Engine::InfoFull info;
+            info.depth    = 30;
+            info.selDepth = 42;
+            info.multiPV  = i + 1;
+            info.score    = {v, pos};
+            info.wdl      = wdl;
+            info.bound    = i % 3 ? "" : "lowerbound";
+            info.timeMs   = 1000 + n;
+            info.nodes    = 123456789 + n;
+            info.nps      = 1234567;
+            info.tbHits   = 0;
+            info.pv       = pv;
+            info.hashfull = 500;
+
+            append_info_full(line, info, true);
+            bytes += line.size();
+        }
+
+    elapsed = now() - elapsed + 1;  // Ensure positivity to avoid a 'divide by zero'
+
+    const uint64_t lines = multiPV * iterations;
+
+    std::cerr << "\n==========================="   //
+              << "\nMultiPV         : " << multiPV  //
+              << "\nInfo lines      : " << lines    //
+              << "\nBytes formatted : " << bytes    //
+              << "\nTotal time (ms) : " << elapsed  //
+              << "\nns/line         : " << elapsed * 1000000 / lines << std::endl;
+}
+
+// Times the move ordering alone: a MovePicker is run over all the moves of some
+// quiet-heavy middlegame positions, with random history tables.
+void UCIEngine::movepick_bench(std::istream& args) {
+    size_t iterations = 20000;
+    args >> iterations;
+
+    Benchmark::RandomHistories h(1070372);
+    std::vector<Position>      positions(std::size(Benchmark::MiddlegameFens));
+    StateInfo                  states[std::size(Benchmark::MiddlegameFens)];
+
+    for (size_t i = 0; i < positions.size(); ++i)
+        positions[i].set(Benchmark::MiddlegameFens[i], false, &states[i]);
+
+    uint64_t  moves   = 0;
+    TimePoint elapsed = now();
+
+    for (size_t n = 0; n < iterations; ++n)
+        for (const Position& pos : positions)
+        {
+            const int ply = int(n % 8);
+
+            MovePicker mp(pos, Move::none(), Depth(1 + n % 12), h.mainHistory.get(),
+                          h.lowPlyHistory.get(), h.captureHistory.get(), h.continuationHistory,
+                          &h.sharedHistory, ply);
+
+            while (mp.next_move())
+                ++moves;
+        }
+
+    elapsed = now() - elapsed + 1;  // Ensure positivity to avoid a 'divide by zero'
+
+    const uint64_t pickers = iterations * positions.size();
+
+    std::cerr << "\n==========================="                         //
+              << "\nMove pickers    : " << pickers                        //
+              << "\nMoves picked    : " << moves                          //
+              << "\nTotal time (ms) : " << elapsed                        //
+              << "\nns/picker       : " << elapsed * 1000000 / pickers    //
+              << "\nns/move         : " << elapsed * 1000000 / moves << std::endl;
+}
+
+// Times the hot kernels in isolation, the JSON results are written to the given
+// file or to the standard output.
+void UCIEngine::microbench(std::istream& args) {
+    std::string file;
+    std::string results = engine.microbench();
+
+    if (!(args >> std::skipws >> file))
+    {
+        sync_cout << results << sync_endl;
+        return;
+    }
+
+    std::ofstream out(file);
+
+    if (!(out << results << '\n'))
+        print_info_string("ERROR: Unable to write the microbenchmark results to " + file);
+}
+
 void UCIEngine::setoption(std::istringstream& is) {
     engine.wait_for_search_finished();
     engine.get_options().setoption(is);
 }
 
+// Saves the transposition table to a file, or restores it, so that a
+// restarted engine can continue an analysis with a warm hash.
+void UCIEngine::hash_file(const std::string& cmd, std::istream& is) {
+    std::string file;
+
+    if (!(is >> std::skipws >> file))
+    {
+        print_info_string("ERROR: " + cmd + " requires a file name");
+        return;
+    }
+
+    const bool save  = cmd == "save_hash";
+    TimePoint  start = now();
+    auto       error = save ? engine.save_tt(file) : engine.load_tt(file);
+
+    if (error)
+        print_info_string("ERROR: " + *error);
+    else
+        print_info_string(std::string(save ? "Hash saved to " : "Hash loaded from ") + file
+                          + " in " + std::to_string(now() - start) + " ms");
+}
+
 std::uint64_t UCIEngine::perft(const Search::LimitsType& limits) {
     auto nodes = engine.perft(engine.fen(), limits.perft, engine.get_options()["UCI_Chess960"]);
     sync_cout << "\nNodes searched: " << nodes << "\n" << sync_endl;
@@ -466,7 +874,19 @@ std::uint64_t UCIEngine::perft(const Search::LimitsType& limits) {
 }
 
 void UCIEngine::position(std::istringstream& is) {
-    std::string token, fen;
+    std::string              fen;
+    std::vector<std::string> moves;
+
+    if (parse_position(is, fen, moves))
+        engine.set_position(fen, moves);
+}
+
+// Parses the arguments of the position command, returns false if there is
+// neither a startpos nor a fen token.
+bool UCIEngine::parse_position(std::istream&             is,
+                               std::string&              fen,
+                               std::vector<std::string>& moves) {
+    std::string token;
 
     is >> token;
 
@@ -479,16 +899,14 @@ void UCIEngine::position(std::istringstream& is) {
         while (is >> token && token != "moves")
             fen += token + " ";
     else
-        return;
-
-    std::vector<std::string> moves;
+        return false;
 
     while (is >> token)
     {
         moves.push_back(token);
     }
 
-    engine.set_position(fen, moves);
+    return true;
 }
 
 namespace {
@@ -516,6 +934,22 @@ WinRateParams win_rate_params(const Position& pos) {
     return {a, b};
 }
 
+// Splits a score in its type and value, type 0 for centipawns and 1 for mate
+std::pair<uint8_t, int> score_fields(const Score& s) {
+    constexpr int TB_CP = 20000;
+    const auto    fields =
+      overload{[](Score::Mate mate) {
+                   auto m = (mate.plies > 0 ? (mate.plies + 1) : mate.plies) / 2;
+                   return std::pair<uint8_t, int>(1, m);
+               },
+               [](Score::Tablebase tb) {
+                   return std::pair<uint8_t, int>(0, tb.win ? TB_CP - tb.plies : -TB_CP - tb.plies);
+               },
+               [](Score::InternalUnits units) { return std::pair<uint8_t, int>(0, units.value); }};
+
+    return s.visit(fields);
+}
+
 // The win rate model is 1 / (1 + exp((a - eval) / b)), where a = p_a(material) and b = p_b(material).
 // It fits the LTC fishtest statistics rather accurately.
 int win_rate_model(Value v, const Position& pos) {
@@ -528,21 +962,14 @@ int win_rate_model(Value v, const Position& pos) {
 }
 
 std::string UCIEngine::format_score(const Score& s) {
-    constexpr int TB_CP = 20000;
-    const auto    format =
-      overload{[](Score::Mate mate) -> std::string {
-                   auto m = (mate.plies > 0 ? (mate.plies + 1) : mate.plies) / 2;
-                   return std::string("mate ") + std::to_string(m);
-               },
-               [](Score::Tablebase tb) -> std::string {
-                   return std::string("cp ")
-                        + std::to_string((tb.win ? TB_CP - tb.plies : -TB_CP - tb.plies));
-               },
-               [](Score::InternalUnits units) -> std::string {
-                   return std::string("cp ") + std::to_string(units.value);
-               }};
+    InfoString str;
+    append_score(str, s);
+    return str;
+}
 
-    return s.visit(format);
+void UCIEngine::append_score(InfoString& out, const Score& s) {
+    const auto [type, value] = score_fields(s);
+    out << (type ? "mate " : "cp ") << value;
 }
 
 // Turns a Value to an integer centipawn number,
@@ -559,14 +986,16 @@ int UCIEngine::to_cp(Value v, const Position& pos) {
 }
 
 std::string UCIEngine::wdl(Value v, const Position& pos) {
-    std::stringstream ss;
+    InfoString str;
+    append_wdl(str, v, pos);
+    return str;
+}
 
+void UCIEngine::append_wdl(InfoString& out, Value v, const Position& pos) {
     int wdl_w = win_rate_model(v, pos);
     int wdl_l = win_rate_model(-v, pos);
     int wdl_d = 1000 - wdl_w - wdl_l;
-    ss << wdl_w << " " << wdl_d << " " << wdl_l;
-
-    return ss.str();
+    out << wdl_w << ' ' << wdl_d << ' ' << wdl_l;
 }
 
 std::string UCIEngine::square(Square s) {
@@ -574,11 +1003,23 @@ std::string UCIEngine::square(Square s) {
 }
 
 std::string UCIEngine::move(Move m, bool chess960) {
+    InfoString str;
+    append_move(str, m, chess960);
+    return str;
+}
+
+void UCIEngine::append_move(InfoString& out, Move m, bool chess960) {
     if (m == Move::none())
-        return "(none)";
+    {
+        out << "(none)";
+        return;
+    }
 
     if (m == Move::null())
-        return "0000";
+    {
+        out << "0000";
+        return;
+    }
 
     Square from = m.from_sq();
     Square to   = m.to_sq();
@@ -586,12 +1027,11 @@ std::string UCIEngine::move(Move m, bool chess960) {
     if (m.type_of() == CASTLING && !chess960)
         to = make_square(to > from ? FILE_G : FILE_C, rank_of(from));
 
-    std::string move = square(from) + square(to);
+    out << char('a' + file_of(from)) << char('1' + rank_of(from))  //
+        << char('a' + file_of(to)) << char('1' + rank_of(to));
 
     if (m.type_of() == PROMOTION)
-        move += " pnbrqk"[m.promotion_type()];
-
-    return move;
+        out << " pnbrqk"[m.promotion_type()];
 }
 
 
@@ -611,51 +1051,264 @@ Move UCIEngine::to_move(const Position& pos, std::string str) {
     return Move::none();
 }
 
+void UCIEngine::append_info_no_moves(InfoString& out, const Engine::InfoShort& info) {
+    out << "info depth " << info.depth << " score ";
+    append_score(out, info.score);
+}
+
+void UCIEngine::append_info_full(InfoString& out, const Engine::InfoFull& info, bool showWDL) {
+    out << "info";
+    out << " depth " << info.depth        //
+        << " seldepth " << info.selDepth  //
+        << " multipv " << info.multiPV    //
+        << " score ";                     //
+
+    append_score(out, info.score);
+
+    if (!info.bound.empty())
+        out << " " << info.bound;
+
+    if (showWDL)
+        out << " wdl " << info.wdl;
+
+    out << " nodes " << info.nodes        //
+        << " nps " << info.nps            //
+        << " hashfull " << info.hashfull  //
+        << " tbhits " << info.tbHits      //
+        << " time " << info.timeMs        //
+        << " pv " << info.pv;             //
+}
+
+void UCIEngine::append_info_iter(InfoString& out, const Engine::InfoIter& info) {
+    out << "info";
+    out << " depth " << info.depth                     //
+        << " currmove " << info.currmove               //
+        << " currmovenumber " << info.currmovenumber;  //
+}
+
+std::string UCIEngine::format_bestmove(std::string_view bestmove, std::string_view ponder) {
+    std::string str = "bestmove " + std::string(bestmove);
+    if (!ponder.empty())
+        str += " ponder " + std::string(ponder);
+    return str;
+}
+
 void UCIEngine::on_update_no_moves(const Engine::InfoShort& info) {
-    sync_cout << "info depth " << info.depth << " score " << format_score(info.score) << sync_endl;
+    InfoString line;
+    append_info_no_moves(line, info);
+    sync_cout << std::string_view(line) << sync_endl;
 }
 
 void UCIEngine::on_update_full(const Engine::InfoFull& info, bool showWDL) {
-    std::stringstream ss;
+    InfoString line;
+    append_info_full(line, info, showWDL);
+    sync_cout << std::string_view(line) << sync_endl;
+}
 
-    ss << "info";
-    ss << " depth " << info.depth                 //
-       << " seldepth " << info.selDepth           //
-       << " multipv " << info.multiPV             //
-       << " score " << format_score(info.score);  //
+void UCIEngine::on_iter(const Engine::InfoIter& info) {
+    InfoString line;
+    append_info_iter(line, info);
+    sync_cout << std::string_view(line) << sync_endl;
+}
+
+void UCIEngine::on_bestmove(std::string_view bestmove, std::string_view ponder) {
+    sync_cout << format_bestmove(bestmove, ponder) << sync_endl;
+}
+
+// The structured output formats replace the info and bestmove lines, any other
+// output stays unchanged. Moves in a PV are the 16-bit encoding of Move, see
+// types.h: bits 0-5 the destination square, bits 6-11 the origin square, bits
+// 12-13 the promotion piece type - 2 and bits 14-15 the move type.
+//
+// With OutputFormat json every line is a JSON object with a "type" field, and
+// the same field names as the analyse_batch output:
+//   {"type": "info", "depth": 20, "seldepth": 28, "multipv": 1, "score": {"cp": 23},
+//    "nodes": 1000, "nps": 2000, "hashfull": 3, "tbhits": 0, "time": 500, "pv": [796, 3372]}
+// plus "bound" and "wdl" when they are sent in text mode. The iteration and
+// bestmove lines keep their moves in UCI notation.
+//
+// With OutputFormat binary every record starts with a type byte below 0x20,
+// thus distinct from the first character of a text line, followed by the
+// payload size as a 16-bit integer. All the integers are little-endian.
+//   1 info:     depth u16, seldepth u16, multipv u16, score type u8 (0 cp, 1 mate),
+//               bound u8 (0 exact, 1 lower, 2 upper), score i32, wdl 3 x u16 (0xFFFF if
+//               not shown), nodes u64, nps u64, tbhits u64, time u64, hashfull u16,
+//               pv length u16, pv moves u16 each
+//   2 iter:     depth u16, currmovenumber u16, currmove as UCI text
+//   3 bestmove: bestmove and ponder as UCI text, separated by a space if any
+//   4 no moves: depth u16, score type u8, score i32
+
+namespace {
+
+enum RecordType : uint8_t {
+    RECORD_INFO = 1,
+    RECORD_ITER,
+    RECORD_BESTMOVE,
+    RECORD_NO_MOVES
+};
+
+template<typename T>
+void put(UCIEngine::InfoString& out, T value) {
+    for (size_t i = 0; i < sizeof(T); ++i)
+        out << char(uint64_t(value) >> (8 * i));
+}
+
+void append_score_json(UCIEngine::InfoString& out, const Score& s) {
+    const auto [type, value] = score_fields(s);
+    out << (type ? "{\"mate\": " : "{\"cp\": ") << value << '}';
+}
+
+void begin_record(UCIEngine::InfoString& record) {
+    record << std::string_view("\0\0\0", 3);  // The header is filled in by end_record()
+}
+
+void write_record(const UCIEngine::InfoString& record) {
+    sync_cout_start();
+    std::cout.write(record.data(), std::streamsize(record.size())) << std::flush;
+    sync_cout_end();
+}
+
+// Fills in the header of a record once the payload has been appended
+void end_record(UCIEngine::InfoString& record, RecordType type) {
+    const size_t payload = record.size() - 3;
+    record[0]            = char(type);
+    record[1]            = char(payload);
+    record[2]            = char(payload >> 8);
+}
+
+}  // namespace
+
+void UCIEngine::on_update_no_moves_json(const Engine::InfoShort& info) {
+    InfoString line;
+    line << "{\"type\": \"info\", \"depth\": " << info.depth << ", \"score\": ";
+    append_score_json(line, info.score);
+    line << '}';
+    sync_cout << std::string_view(line) << sync_endl;
+}
+
+void UCIEngine::on_update_full_json(const Engine::InfoFull& info, bool showWDL) {
+    InfoString line;
+
+    line << "{\"type\": \"info\""                   //
+         << ", \"depth\": " << info.depth          //
+         << ", \"seldepth\": " << info.selDepth    //
+         << ", \"multipv\": " << info.multiPV      //
+         << ", \"score\": ";
+
+    append_score_json(line, info.score);
 
     if (!info.bound.empty())
-        ss << " " << info.bound;
+        line << ", \"bound\": \"" << info.bound << '"';
 
     if (showWDL)
-        ss << " wdl " << info.wdl;
+    {
+        line << ", \"wdl\": [";
+        for (auto v : split(info.wdl, " "))
+            line << (v.data() != info.wdl.data() ? ", " : "") << v;
+        line << ']';
+    }
 
-    ss << " nodes " << info.nodes        //
-       << " nps " << info.nps            //
-       << " hashfull " << info.hashfull  //
-       << " tbhits " << info.tbHits      //
-       << " time " << info.timeMs        //
-       << " pv " << info.pv;             //
+    line << ", \"nodes\": " << info.nodes        //
+         << ", \"nps\": " << info.nps            //
+         << ", \"hashfull\": " << info.hashfull  //
+         << ", \"tbhits\": " << info.tbHits      //
+         << ", \"time\": " << info.timeMs        //
+         << ", \"pv\": [";
 
-    sync_cout << ss.str() << sync_endl;
+    for (size_t i = 0; i < info.pvLength; ++i)
+        line << (i ? ", " : "") << info.pvMoves[i].raw();
+
+    line << "]}";
+    sync_cout << std::string_view(line) << sync_endl;
 }
 
-void UCIEngine::on_iter(const Engine::InfoIter& info) {
-    std::stringstream ss;
+void UCIEngine::on_iter_json(const Engine::InfoIter& info) {
+    InfoString line;
+    line << "{\"type\": \"iter\", \"depth\": " << info.depth << ", \"currmove\": \""
+         << info.currmove << "\", \"currmovenumber\": " << info.currmovenumber << '}';
+    sync_cout << std::string_view(line) << sync_endl;
+}
+
+void UCIEngine::on_bestmove_json(std::string_view bestmove, std::string_view ponder) {
+    InfoString line;
+    line << "{\"type\": \"bestmove\", \"bestmove\": \"" << bestmove << '"';
+    if (!ponder.empty())
+        line << ", \"ponder\": \"" << ponder << '"';
+    line << '}';
+    sync_cout << std::string_view(line) << sync_endl;
+}
 
-    ss << "info";
-    ss << " depth " << info.depth                     //
-       << " currmove " << info.currmove               //
-       << " currmovenumber " << info.currmovenumber;  //
+void UCIEngine::on_update_no_moves_binary(const Engine::InfoShort& info) {
+    InfoString record;
+    const auto [type, value] = score_fields(info.score);
 
-    sync_cout << ss.str() << sync_endl;
+    begin_record(record);
+    put<uint16_t>(record, uint16_t(info.depth));
+    put<uint8_t>(record, type);
+    put<int32_t>(record, value);
+    end_record(record, RECORD_NO_MOVES);
+    write_record(record);
 }
 
-void UCIEngine::on_bestmove(std::string_view bestmove, std::string_view ponder) {
-    sync_cout << "bestmove " << bestmove;
+void UCIEngine::on_update_full_binary(const Engine::InfoFull& info) {
+    InfoString record;
+    const auto [type, value] = score_fields(info.score);
+
+    uint16_t wdl[3] = {0xFFFF, 0xFFFF, 0xFFFF};
+    auto     wdlStr = info.wdl;
+
+    for (int i = 0; i < 3 && !wdlStr.empty(); ++i)
+    {
+        const auto [end, ec] =
+          std::from_chars(wdlStr.data(), wdlStr.data() + wdlStr.size(), wdl[i]);
+        wdlStr.remove_prefix(std::min(wdlStr.size(), size_t(end - wdlStr.data()) + 1));
+    }
+
+    begin_record(record);
+    put<uint16_t>(record, uint16_t(info.depth));
+    put<uint16_t>(record, uint16_t(info.selDepth));
+    put<uint16_t>(record, uint16_t(info.multiPV));
+    put<uint8_t>(record, type);
+    put<uint8_t>(record, info.bound == "lowerbound" ? 1 : info.bound == "upperbound" ? 2 : 0);
+    put<int32_t>(record, value);
+
+    for (uint16_t w : wdl)
+        put<uint16_t>(record, w);
+
+    put<uint64_t>(record, info.nodes);
+    put<uint64_t>(record, info.nps);
+    put<uint64_t>(record, info.tbHits);
+    put<uint64_t>(record, info.timeMs);
+    put<uint16_t>(record, uint16_t(info.hashfull));
+    put<uint16_t>(record, uint16_t(info.pvLength));
+
+    for (size_t i = 0; i < info.pvLength; ++i)
+        put<uint16_t>(record, info.pvMoves[i].raw());
+
+    end_record(record, RECORD_INFO);
+    write_record(record);
+}
+
+void UCIEngine::on_iter_binary(const Engine::InfoIter& info) {
+    InfoString record;
+
+    begin_record(record);
+    put<uint16_t>(record, uint16_t(info.depth));
+    put<uint16_t>(record, uint16_t(info.currmovenumber));
+    record << info.currmove;
+    end_record(record, RECORD_ITER);
+    write_record(record);
+}
+
+void UCIEngine::on_bestmove_binary(std::string_view bestmove, std::string_view ponder) {
+    InfoString record;
+
+    begin_record(record);
+    record << bestmove;
     if (!ponder.empty())
-        std::cout << " ponder " << ponder;
-    std::cout << sync_endl;
+        record << ' ' << ponder;
+    end_record(record, RECORD_BESTMOVE);
+    write_record(record);
 }
 
 }  // namespace Stockfish
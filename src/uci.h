@@ -23,6 +23,7 @@
 #include <iostream>
 #include <string>
 #include <string_view>
+#include <vector>
 
 #include "engine.h"
 #include "misc.h"
@@ -38,6 +39,10 @@ using Value = int;
 
 class UCIEngine {
    public:
+    // Large enough for an info line with a PV of MAX_PLY moves, in any output
+    // format: up to 7 characters per move in JSON.
+    using InfoString = FixedString<MAX_PLY * 8 + 256>;
+
     UCIEngine(int argc, char** argv);
 
     void loop();
@@ -51,6 +56,17 @@ class UCIEngine {
     static Move        to_move(const Position& pos, std::string str);
 
     static Search::LimitsType parse_limits(std::istream& is);
+    static bool parse_position(std::istream& is, std::string& fen, std::vector<std::string>& moves);
+
+    static std::string format_bestmove(std::string_view bestmove, std::string_view ponder);
+
+    // Formatting of the info lines, without heap allocation
+    static void append_move(InfoString& out, Move m, bool chess960);
+    static void append_score(InfoString& out, const Score& s);
+    static void append_wdl(InfoString& out, Value v, const Position& pos);
+    static void append_info_no_moves(InfoString& out, const Engine::InfoShort& info);
+    static void append_info_full(InfoString& out, const Engine::InfoFull& info, bool showWDL);
+    static void append_info_iter(InfoString& out, const Engine::InfoIter& info);
 
     auto& engine_options() { return engine.get_options(); }
 
@@ -63,8 +79,14 @@ class UCIEngine {
     void          go(std::istringstream& is);
     void          bench(std::istream& args);
     void          benchmark(std::istream& args);
+    void          analyse_batch(std::istream& args);
+    void          analyse_moves(std::istream& args);
+    void          info_bench(std::istream& args);
+    void          movepick_bench(std::istream& args);
+    void          microbench(std::istream& args);
     void          position(std::istringstream& is);
     void          setoption(std::istringstream& is);
+    void          hash_file(const std::string& cmd, std::istream& is);
     std::uint64_t perft(const Search::LimitsType&);
 
     static void on_update_no_moves(const Engine::InfoShort& info);
@@ -72,6 +94,16 @@ class UCIEngine {
     static void on_iter(const Engine::InfoIter& info);
     static void on_bestmove(std::string_view bestmove, std::string_view ponder);
 
+    static void on_update_no_moves_json(const Engine::InfoShort& info);
+    static void on_update_full_json(const Engine::InfoFull& info, bool showWDL);
+    static void on_iter_json(const Engine::InfoIter& info);
+    static void on_bestmove_json(std::string_view bestmove, std::string_view ponder);
+
+    static void on_update_no_moves_binary(const Engine::InfoShort& info);
+    static void on_update_full_binary(const Engine::InfoFull& info);
+    static void on_iter_binary(const Engine::InfoIter& info);
+    static void on_bestmove_binary(std::string_view bestmove, std::string_view ponder);
+
     void init_search_update_listeners();
 };
 
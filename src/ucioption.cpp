@@ -133,7 +133,7 @@ Option::operator int() const {
 }
 
 Option::operator std::string() const {
-    assert(type == "string");
+    assert(type == "string" || type == "combo");
     return currentValue;
 }
 
@@ -163,7 +163,8 @@ Option& Option::operator=(const std::string& v) {
         std::string        token;
         std::istringstream ss(defaultValue);
         while (ss >> token)
-            comboMap.add(token, Option());
+            if (!comboMap.count(token))  // The default value is also listed as a var
+                comboMap.add(token, Option());
         if (!comboMap.count(v) || v == "var")
             return *this;
     }
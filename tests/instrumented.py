@@ -4,6 +4,7 @@ import sys
 import subprocess
 import pathlib
 import os
+import socket
 
 from testing import (
     EPD,
@@ -147,6 +148,13 @@ class TestCLI(metaclass=OrderedClassMembers):
         )
         assert self.stockfish.process.returncode == 0
 
+    def test_analyse_batch_bench_tmp_epd_depth_5(self):
+        self.stockfish = Stockfish(
+            f"analyse_batch {os.path.join(PATH, 'bench_tmp.epd')} depth 5".split(" "),
+            True,
+        )
+        assert self.stockfish.process.returncode == 0
+
     def test_d(self):
         self.stockfish = Stockfish("d".split(" "), True)
         assert self.stockfish.process.returncode == 0
@@ -155,6 +163,140 @@ class TestCLI(metaclass=OrderedClassMembers):
         self.stockfish = Stockfish("compiler".split(" "), True)
         assert self.stockfish.process.returncode == 0
 
+    def test_stats(self):
+        self.stockfish = Stockfish("stats".split(" "), True)
+        assert self.stockfish.process.returncode == 0
+
+    def test_infobench(self):
+        self.stockfish = Stockfish("infobench 50 100".split(" "), True)
+        assert self.stockfish.process.returncode == 0
+
+    def test_movepickbench(self):
+        self.stockfish = Stockfish("movepickbench 100".split(" "), True)
+        assert self.stockfish.process.returncode == 0
+
+    def test_microbench(self):
+        self.stockfish = Stockfish("microbench".split(" "), True)
+        assert self.stockfish.process.returncode == 0
+
+    def test_speedtest_json(self):
+        self.stockfish = Stockfish("speedtest 1 16 1 runs 2 json".split(" "), True)
+        assert self.stockfish.process.returncode == 0
+        assert '"nps_median": ' in self.stockfish.process.stdout
+
+    def test_startup_profile(self):
+        self.stockfish = Stockfish("--startup-profile uci".split(" "), True)
+        assert self.stockfish.process.returncode == 0
+
+    def test_sessions(self):
+        # With a budget of one thread the searches run in the order of their go
+        self.stockfish = Stockfish("--sessions 1".split(" "))
+        self.stockfish.send_command("a position startpos moves e2e4")
+        self.stockfish.send_command("b setoption name Threads value 2")
+        self.stockfish.expect("b info string Threads limited to the budget of 1 of the host")
+        self.stockfish.send_command("a go depth 8")
+        self.stockfish.send_command("b go depth 8")
+        self.stockfish.expect("a bestmove *")
+        self.stockfish.expect("b bestmove *")
+        self.stockfish.send_command("b quit")
+        self.stockfish.send_command("a isready")
+        self.stockfish.equals("a readyok")
+
+        # A line with a session name only is ignored
+        self.stockfish.send_command("c")
+        self.stockfish.send_command("a isready")
+        self.stockfish.expect("* readyok")
+        assert self.stockfish.get_output()[-1] == "a readyok"
+
+        self.stockfish.quit()
+        assert self.stockfish.close() == 0
+
+    def test_server(self):
+        self.stockfish = Stockfish("--server server.sock 1".split(" "))
+        self.stockfish.expect("info string Listening on server.sock")
+
+        # Pipelined commands, sent before any answer is read
+        client = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        client.connect("server.sock")
+        client.sendall(b"isready\nposition startpos\ngo depth 6\n")
+
+        received = b""
+        while b"bestmove" not in received:
+            data = client.recv(4096)
+            assert data
+            received += data
+
+        assert received.startswith(b"readyok\n")
+        client.close()
+
+        self.stockfish.quit()
+        assert self.stockfish.close() == 0
+        assert not os.path.exists("server.sock")
+
+    def test_server_blocking_commands(self):
+        self.stockfish = Stockfish("--server server.sock 2".split(" "))
+        self.stockfish.expect("info string Listening on server.sock")
+
+        # setoption and ucinewgame wait for the search, which only the stop
+        # sent after them ends, while the other client is still served
+        searching = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        searching.connect("server.sock")
+        searching.sendall(
+            b"position startpos\ngo infinite\nsetoption name Hash value 32\n"
+            b"ucinewgame\nisready\nstop\n"
+        )
+
+        other = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        other.connect("server.sock")
+        other.sendall(b"isready\n")
+        assert other.recv(4096) == b"readyok\n"
+        other.close()
+
+        received = b""
+        while b"readyok" not in received:
+            data = searching.recv(4096)
+            assert data
+            received += data
+
+        assert b"bestmove" in received.split(b"readyok")[0]
+        searching.close()
+
+        self.stockfish.quit()
+        assert self.stockfish.close() == 0
+
+    def test_server_quit_during_search(self):
+        self.stockfish = Stockfish("--server server.sock 2".split(" "))
+        self.stockfish.expect("info string Listening on server.sock")
+
+        # The session is torn down off the server loop: the other client is
+        # served while the search and the queued setoption finish, and the
+        # socket is closed after the best move
+        searching = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        searching.connect("server.sock")
+        searching.sendall(b"go infinite\nsetoption name Hash value 64\nquit\n")
+
+        other = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        other.connect("server.sock")
+        other.sendall(b"isready\n")
+        assert other.recv(4096) == b"readyok\n"
+
+        received = b""
+        while True:
+            data = searching.recv(4096)
+            if not data:
+                break
+            received += data
+
+        assert b"bestmove" in received
+        searching.close()
+
+        other.sendall(b"isready\n")
+        assert other.recv(4096) == b"readyok\n"
+        other.close()
+
+        self.stockfish.quit()
+        assert self.stockfish.close() == 0
+
     def test_license(self):
         self.stockfish = Stockfish("license".split(" "), True)
         assert self.stockfish.process.returncode == 0
@@ -291,6 +433,71 @@ class TestInteractive(metaclass=OrderedClassMembers):
     def test_clear_hash(self):
         self.stockfish.send_command("setoption name Clear Hash")
 
+    def test_hash_numa_modes(self):
+        for mode in ["partitioned", "replicated", "shared"]:
+            self.stockfish.send_command(f"setoption name HashNumaMode value {mode}")
+            self.stockfish.send_command("ucinewgame")
+            self.stockfish.send_command("position startpos")
+            self.stockfish.send_command("go depth 8")
+            self.stockfish.starts_with("bestmove")
+
+    def test_save_and_load_hash(self):
+        hash_file = os.path.join(os.path.abspath(os.getcwd()), "hash.bin")
+
+        self.stockfish.send_command("ucinewgame")
+        self.stockfish.send_command("position startpos")
+        self.stockfish.send_command("go depth 8")
+        self.stockfish.starts_with("bestmove")
+
+        self.stockfish.send_command(f"save_hash {hash_file}")
+        self.stockfish.starts_with("info string Hash saved to")
+        self.stockfish.send_command(f"load_hash {hash_file}")
+        self.stockfish.starts_with("info string Hash loaded from")
+
+        os.remove(hash_file)
+
+    def test_telemetry_csv(self):
+        telemetry_file = os.path.join(os.path.abspath(os.getcwd()), "telemetry.csv")
+
+        self.stockfish.send_command("setoption name TelemetryFormat value csv")
+        self.stockfish.send_command(f"setoption name TelemetryFile value {telemetry_file}")
+        self.stockfish.starts_with("info string Telemetry written to")
+        self.stockfish.send_command("ucinewgame")
+        self.stockfish.send_command("position startpos")
+        self.stockfish.send_command("go depth 8")
+        self.stockfish.starts_with("bestmove")
+
+        # Changing the interval keeps the rows of the previous searches
+        self.stockfish.send_command("setoption name TelemetryInterval value 500")
+        self.stockfish.starts_with("info string Telemetry written to")
+        self.stockfish.send_command("go depth 8")
+        self.stockfish.starts_with("bestmove")
+
+        self.stockfish.send_command("setoption name TelemetryFile value")
+        self.stockfish.send_command("setoption name TelemetryFormat value prometheus")
+        self.stockfish.send_command("setoption name TelemetryInterval value 1000")
+        self.stockfish.send_command("isready")
+        self.stockfish.equals("readyok")
+
+        with open(telemetry_file) as f:
+            lines = f.read().splitlines()
+
+        assert lines[0].startswith("search,time_ms,nodes,nps")
+        assert sum(line.startswith("search,") for line in lines) == 1
+        assert any(line.startswith("1,") for line in lines)
+        assert lines[-1].startswith("2,")
+
+        os.remove(telemetry_file)
+
+    def test_parallel_perft_with_hash(self):
+        self.stockfish.send_command("setoption name PerftHash value 16")
+        self.stockfish.send_command(
+            "position fen r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq -"
+        )
+        self.stockfish.send_command("go perft 4")
+        self.stockfish.equals("Nodes searched: 4085603")
+        self.stockfish.send_command("setoption name PerftHash value 0")
+
     def test_fen_position_mate_1(self):
         self.stockfish.send_command("ucinewgame")
         self.stockfish.send_command(
@@ -397,12 +604,41 @@ class TestInteractive(metaclass=OrderedClassMembers):
         self.stockfish.send_command("go depth 5")
         self.stockfish.starts_with("bestmove")
 
+    def test_verify_raw_nnue_network(self):
+        current_path = os.path.abspath(os.getcwd())
+        Stockfish(
+            f"export_raw_net {os.path.join(current_path, 'verify.raw')}".split(" "), True
+        )
+
+        self.stockfish.send_command("setoption name EvalFile value verify.raw")
+        self.stockfish.send_command("position startpos")
+        self.stockfish.send_command("go depth 5")
+        self.stockfish.expect("info string NNUE evaluation using verify.raw *")
+        self.stockfish.starts_with("bestmove")
+
     def test_multipv_setting(self):
         self.stockfish.send_command("setoption name MultiPV value 4")
         self.stockfish.send_command("position startpos")
         self.stockfish.send_command("go depth 5")
         self.stockfish.starts_with("bestmove")
 
+    def test_multipv_kbest_search(self):
+        self.stockfish.send_command("setoption name MultiPV value 4")
+        self.stockfish.send_command("setoption name MultiPVSearch value kbest")
+        self.stockfish.send_command("position startpos")
+        self.stockfish.send_command("go depth 8")
+        self.stockfish.expect("info depth 8 seldepth * multipv 4 score *")
+        self.stockfish.starts_with("bestmove")
+        self.stockfish.send_command("setoption name MultiPVSearch value sequential")
+
+    def test_analyse_moves_split_over_threads(self):
+        self.stockfish.send_command("setoption name Threads value 2")
+        self.stockfish.send_command("position startpos moves e2e4")
+        self.stockfish.send_command("analyse_moves depth 6 searchmoves e7e5 c7c5 e7e6")
+        self.stockfish.expect("info depth 6 seldepth * multipv 1 score *")
+        self.stockfish.expect("info depth 6 seldepth * multipv 3 score *")
+        self.stockfish.send_command("setoption name Threads value 1")
+
     def test_fen_position_with_skill_level(self):
         self.stockfish.send_command("setoption name Skill Level value 10")
         self.stockfish.send_command("position startpos")
@@ -411,6 +647,30 @@ class TestInteractive(metaclass=OrderedClassMembers):
 
         self.stockfish.send_command("setoption name Skill Level value 20")
 
+    def test_thread_spin_and_start_together(self):
+        self.stockfish.send_command("setoption name Threads value 3")
+        self.stockfish.send_command("setoption name ThreadSpin value 500")
+        self.stockfish.send_command("setoption name ThreadStart value together")
+        self.stockfish.send_command("ucinewgame")
+        self.stockfish.send_command("position startpos")
+        self.stockfish.send_command("go depth 6")
+        self.stockfish.expect("bestmove *")
+        self.stockfish.send_command("stats")
+        self.stockfish.expect("Helper threads searching: * us after go")
+        self.stockfish.send_command("stats")
+        self.stockfish.expect("NNUE accumulators: * KiB over 3 threads")
+        self.stockfish.send_command("setoption name ThreadStart value staggered")
+        self.stockfish.send_command("setoption name ThreadSpin value 0")
+        self.stockfish.send_command("setoption name Threads value 1")
+
+    def test_output_format_json(self):
+        self.stockfish.send_command("setoption name OutputFormat value json")
+        self.stockfish.send_command("position startpos")
+        self.stockfish.send_command("go depth 5")
+        self.stockfish.expect('{"type": "info", "depth": 5, *"pv": *')
+        self.stockfish.expect('{"type": "bestmove", "bestmove": "*"*}')
+        self.stockfish.send_command("setoption name OutputFormat value text")
+
 
 class TestSyzygy(metaclass=OrderedClassMembers):
     def beforeAll(self):
@@ -474,6 +734,62 @@ class TestSyzygy(metaclass=OrderedClassMembers):
         self.stockfish.check_output(check_output)
         self.stockfish.expect("bestmove *")
 
+    def test_syzygy_cache(self):
+        self.stockfish.send_command("setoption name SyzygyCacheSize value 64")
+        self.stockfish.send_command("ucinewgame")
+        self.stockfish.send_command("position fen 8/8/8/3k4/8/2PK4/8/8 w - - 0 1")
+        self.stockfish.send_command("go depth 10")
+        self.stockfish.expect("bestmove *")
+        self.stockfish.send_command("stats")
+
+        def check_output(output):
+            if output.startswith("Syzygy cache hits:") and not output.endswith(" 0 probes"):
+                return True
+
+        self.stockfish.check_output(check_output)
+
+    def test_syzygy_warmup_and_prefetch(self):
+        self.stockfish.send_command("setoption name SyzygyWarmup value 4")
+        self.stockfish.send_command("setoption name SyzygyPrefetch value true")
+        self.stockfish.send_command("setoption name SyzygyProbeLimit value 4")
+        self.stockfish.send_command("ucinewgame")
+        self.stockfish.send_command("position fen 8/8/8/2nk4/8/2PK4/3P4/8 w - - 0 1")
+        self.stockfish.send_command("go depth 12")
+        self.stockfish.expect("bestmove *")
+        self.stockfish.send_command("stats")
+        self.stockfish.expect(
+            "Syzygy stalls: * tables mapped during search, * probes slower than 1 ms"
+        )
+        self.stockfish.send_command("setoption name SyzygyWarmup value 0")
+        self.stockfish.send_command("setoption name SyzygyPrefetch value false")
+        self.stockfish.send_command("setoption name SyzygyProbeLimit value 7")
+
+    def test_syzygy_extended_pv(self):
+        # Without the 50-move rule the PV is extended by the tablebases up to the mate
+        self.stockfish.send_command("setoption name Syzygy50MoveRule value false")
+        self.stockfish.send_command("ucinewgame")
+        self.stockfish.send_command("position fen 8/8/8/3k4/8/8/8/KBN5 w - - 0 1")
+        self.stockfish.send_command("go depth 5")
+
+        def check_output(output):
+            if output.startswith("info depth 5 ") and "score cp 20000" in output:
+                return len(output.split(" pv ")[1].split()) >= 30
+
+        self.stockfish.check_output(check_output)
+        self.stockfish.expect("bestmove *")
+
+        self.stockfish.send_command("setoption name OutputFormat value json")
+        self.stockfish.send_command("go depth 5")
+
+        def check_output_json(output):
+            if '"depth": 5,' in output and '"score": {"cp": 20000}' in output:
+                return len(output.split('"pv": ')[1].split(",")) >= 30
+
+        self.stockfish.check_output(check_output_json)
+        self.stockfish.expect('{"type": "bestmove", "bestmove": "*"*}')
+        self.stockfish.send_command("setoption name OutputFormat value text")
+        self.stockfish.send_command("setoption name Syzygy50MoveRule value true")
+
 
 def parse_args():
     parser = argparse.ArgumentParser(description="Run Stockfish with testing options")
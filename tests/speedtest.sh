@@ -0,0 +1,72 @@
+#!/bin/bash
+# obtain and optionally gate the speedtest throughput
+# if no baseline is given, the JSON of the run is printed, so that it can be stored as a baseline
+# usage: speedtest.sh [baseline.json [allowed drop of the median nps in percent, default 5]]
+# SPEEDTEST_ARGS (default "1 16 10") and SPEEDTEST_RUNS (default 5) choose the speedtest run
+
+STDOUT_FILE=$(mktemp)
+STDERR_FILE=$(mktemp)
+
+error()
+{
+  echo "running speedtest failed on line $1"
+  echo "===== STDOUT ====="
+  cat "$STDOUT_FILE"
+  echo "===== STDERR ====="
+  cat "$STDERR_FILE"
+  rm -f "$STDOUT_FILE" "$STDERR_FILE"
+  exit 1
+}
+trap 'error ${LINENO}' ERR
+
+# obtain
+eval "$RUN_PREFIX ./stockfish speedtest ${SPEEDTEST_ARGS:-1 16 10} runs ${SPEEDTEST_RUNS:-5} json" \
+  > "$STDOUT_FILE" 2> "$STDERR_FILE" || error ${LINENO}
+result=$(sed -n '/^{/,/^}/p' "$STDOUT_FILE")
+
+rm -f "$STDOUT_FILE" "$STDERR_FILE"
+
+# numeric field of a speedtest JSON, one field per line
+field()
+{
+  echo "$1" | grep "\"$2\":" | tr -dc '0-9'
+}
+
+invocation()
+{
+  echo "$1" | grep '"invocation":' | cut -d '"' -f 4
+}
+
+median=$(field "$result" nps_median)
+
+if [ -z "$median" ]; then
+   echo "No throughput obtained from speedtest. Code crashed or assert triggered ?"
+   exit 1
+fi
+
+if [ $# -gt 0 ]; then
+   # compare to given baseline
+   baseline=$(cat "$1")
+   threshold=${2:-5}
+
+   if [ "$(invocation "$baseline")" != "$(invocation "$result")" ]; then
+      echo "speedtest mismatch: baseline ran '$(invocation "$baseline")'" \
+           "obtained '$(invocation "$result")' ."
+      exit 1
+   fi
+
+   reference=$(field "$baseline" nps_median)
+   limit=$(awk -v r="$reference" -v t="$threshold" 'BEGIN { printf "%d", r * (100 - t) / 100 }')
+   ci="95% CI $(field "$result" nps_ci_low)-$(field "$result" nps_ci_high)"
+
+   if [ "$median" -lt "$limit" ]; then
+      echo "throughput regression: reference $reference nps obtained: $median nps ($ci)," \
+           "more than $threshold% below the reference ."
+      exit 1
+   else
+      echo "throughput OK: $median nps ($ci), reference $reference nps"
+   fi
+else
+   # just report the run
+   echo "$result"
+fi